@@ -6,6 +6,7 @@
  */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <ctype.h>
 
 
@@ -119,19 +120,33 @@ Sub codes:
 				  These can still be encoded using 001bbbbb. If all bits are one that can be
 				  encoded as -1 and then displayed as 0xFFFFFFFFFFFFFFFF.
 				4
-				  embedded byte buffer follows, to be displayed in hex.
-				  Perhaps first number after this shall be used to tell how
-				  many bytes there is in the byte buffer. In each of the following
-				  number codes 4 bytes of binary data is then stored.
+				  A packed array of binary numbers follows. Three codes:
+				  	  1) Element size in bytes (1, 2 or 4).
+				  	  2) Number of elements.
+				  	  3) The data, a 01000000 start sub code followed by extension
+				  	     sub codes. The elements are packed as a bit stream with 7 bits
+				  	     in each extension sub code, least significant bits first.
+				  	     Two's complement is used for negative numbers.
+				  A DBF decoder not knowing about this will see 3 numbers, the last
+				  one is large but that is fine since it only needs to skip it.
+				  Since only extension sub codes are used for the data no begin
+				  or end codes can occur in it.
+				2
+				  A compact string follows. Same as 1 but number codes n >= 64
+				  are words from a dictionary (dbfStringDictionary), n - 64 is
+				  the index of the word. These take 2 bytes so words of 3 or
+				  more characters are sent with fewer bytes than as characters.
+				  Words may only be added at end of dictionary, sender and
+				  receiver must agree on it.
 				5
-				  binary64 floating point format.
-				  64-bit IEEE 754 floating point, 1 sign, 11 exponent and 52 mantissa bits
-				  mantissa is perhaps better called coefficient or significand.
-				  Probably it shall be encoded into 2 codes.
-				  	  1) sign and significand/mantissa
-				  	  2) exponent
-				  Note that the exponent is then for power of 2 not power of 10 as in Scientific notation.
-				  If that can be changed to 10 without to much complexity it would make a log so much more readable.
+				  One or more decimal numbers follow. Each is encoded as 2 number codes.
+				  	  1) mantissa (AKA significand), a signed integer.
+				  	  2) exponent, a signed integer, for power of 10.
+				  The value is mantissa * 10^exponent. Example 231.5 is sent as 2315, -1.
+				  Power of 10 is used (not 2 as in IEEE 754) so that readings from
+				  instruments can be passed on exactly as they were given and so that
+				  a log is readable. Trailing zeros are removed from the mantissa
+				  so that small numbers fit in one byte each.
 				6 and 7
 				  Begin and end of a JSON style object '{' '}' respectively.
                                   Remember to diplay with the ':' as delimiter also.
@@ -142,19 +157,19 @@ Sub codes:
 
 
 00001bbb
-	Currently reserved for future use. Perhaps to be used as below:
-
 		If this code is received in the beginning of a message, before any
 		of these: 01bbbbbb, 001bbbbb, 0001bbbb it is a version code. If this is
 		received inside a message it is a repetition code.
 
 		repetition code
 
-	In future the plan is to use this for repeating codes.
-	Such as if previous code is repeated a number of times then this is sent instead
+	If previous code is repeated a number of times then this is sent instead
 	to say how many times. Only number codes (positive or negative) can be repeated
 	this way. n will tell how many extra repetitions. The number of extra repetitions
 	shall be n+1.
+	Example: 7, 7, 7, 7 is encoded as 7 followed by repetition code with n = 2.
+	DbfSerializer does this for integers automatically, the read functions in
+	DbfUnserializer give the repeated number as if it had been sent every time.
 
 	Currently if "Extension code" or "repetition code" is found as the first code in a
 			message (before any	of these: 01bbbbbb, 001bbbbb, 0001bbbb) then its an error
@@ -184,8 +199,6 @@ Sub codes:
 				that shall be ignored if unknown to the receiver.
 
 0000001b
-	Currently reserved for future use. Perhaps to be used as below:
-
 		If this code is received in the beginning of a message, before any
 		of these: 01bbbbbb, 001bbbbb, 0001bbbb it is a networking option. If this is
 	received inside a message it is something else, not defined yet.
@@ -195,9 +208,13 @@ Sub codes:
 	Networking options are not regarded do be part of the message body for
 	which the CRC is calculated mentioned for 0001bbbb.
 
-	Perhaps this will be used for a Time To Live (TTL) counter used when routing/forwarding
-	messages. Not being part of the CRC means it can be decremented without needed to
-	recalculate the CRC.
+	Time To Live (TTL)
+		n is a counter used when forwarding messages. It is the number
+		of more times the message may be forwarded, a message with n = 0 is not
+		forwarded. Each forwarding node writes it as the first code with n
+		one less than it was received. Not being part of the CRC means it can be
+		decremented without needed to recalculate the CRC. See DbfSerializerWriteTtl
+		and DbfFrameReadTtl.
 		Other
 	If this code is received in the middle of a message and it is unknown to the receiver
 	then it may be ignored and shall not be displayed.
@@ -248,11 +265,22 @@ static void logHex(FILE* stream, const char *prefix, const unsigned char *ptr, u
 }
 */
 
+void DbfSerializerInitBuffer(DbfSerializer *dbfSerializer, char *bufPtr, unsigned int bufSize)
+{
+	dbfSerializer->buffer = bufPtr;
+	dbfSerializer->capacity = bufSize;
+	DbfSerializerInit(dbfSerializer);
+}
+
 void DbfSerializerInit(DbfSerializer *dbfSerializer)
 {
 	//dbfDebugLog("DbfSerializerInit");
 	dbfSerializer->pos = 0;
+	dbfSerializer->overflow = 0;
 	dbfSerializer->encoderState = DBF_ENCODER_IDLE;
+	dbfSerializer->repeatCount = 0;
+	dbfSerializer->crc = crc32_init();
+	dbfSerializer->crcPos = 0;
 //#if defined __linux__ || defined __WIN32
 //	dbfSerializer->debugState = 0;
 //#endif
@@ -262,19 +290,89 @@ void DbfSerializerResetMesssage(DbfSerializer *dbfSerializer)
 {
 	//dbfDebugLog("DbfSerializerResetMesssage");
 	dbfSerializer->pos = 0;
+	dbfSerializer->overflow = 0;
 	dbfSerializer->encoderState = DBF_ENCODER_IDLE;
+	dbfSerializer->repeatCount = 0;
+	dbfSerializer->crc = crc32_init();
+	dbfSerializer->crcPos = 0;
 //#if defined __linux__ || defined __WIN32
 //	dbfSerializer->debugState = 0;
 //#endif
 }
 
+int DbfTemplateSave(DbfTemplate *dbfTemplate, const DbfSerializer *dbfSerializer)
+{
+	// A cut off header shall not be used for later messages.
+	if ((dbfSerializer->overflow) || (dbfSerializer->pos > sizeof(dbfTemplate->buffer)))
+	{
+		dbfTemplate->len = 0;
+		return -1;
+	}
+	for(unsigned int i = 0; i < dbfSerializer->pos; i++)
+	{
+		dbfTemplate->buffer[i] = dbfSerializer->buffer[i];
+	}
+	dbfTemplate->len = dbfSerializer->pos;
+	dbfTemplate->encoderState = dbfSerializer->encoderState;
+	dbfTemplate->lastValue = dbfSerializer->lastValue;
+	dbfTemplate->repeatCount = dbfSerializer->repeatCount;
+	dbfTemplate->repeatPos = dbfSerializer->repeatPos;
+	dbfTemplate->crc = dbfSerializer->crc;
+	dbfTemplate->crcPos = dbfSerializer->crcPos;
+	return 0;
+}
+
+void DbfSerializerInitFromTemplate(DbfSerializer *dbfSerializer, const DbfTemplate *dbfTemplate)
+{
+	if (dbfTemplate->len > dbfSerializer->capacity)
+	{
+		DbfSerializerInit(dbfSerializer);
+		dbfSerializer->overflow = 1;
+		return;
+	}
+	for(unsigned int i = 0; i < dbfTemplate->len; i++)
+	{
+		dbfSerializer->buffer[i] = dbfTemplate->buffer[i];
+	}
+	dbfSerializer->pos = dbfTemplate->len;
+	dbfSerializer->encoderState = dbfTemplate->encoderState;
+	dbfSerializer->lastValue = dbfTemplate->lastValue;
+	dbfSerializer->repeatCount = dbfTemplate->repeatCount;
+	dbfSerializer->repeatPos = dbfTemplate->repeatPos;
+	dbfSerializer->crc = dbfTemplate->crc;
+	dbfSerializer->crcPos = dbfTemplate->crcPos;
+	dbfSerializer->overflow = 0;
+}
+
+int DbfSerializerIsOverflow(const DbfSerializer *dbfSerializer)
+{
+	return dbfSerializer->overflow;
+}
+
+/**
+ * The CRC is calculated as the message is written. Bytes are added
+ * to the CRC when the next code is written, not when written themselves,
+ * since the last code may be replaced (see DbfSerializerWriteRepeat).
+ * So when the message is sent only its last code remains to be added.
+ */
+static inline void DbfSerializerCrcUpdate(DbfSerializer *dbfSerializer)
+{
+	if (dbfSerializer->crcPos < dbfSerializer->pos)
+	{
+		dbfSerializer->crc = crc32_update(dbfSerializer->crc, (const unsigned char *)dbfSerializer->buffer + dbfSerializer->crcPos, dbfSerializer->pos - dbfSerializer->crcPos);
+		dbfSerializer->crcPos = dbfSerializer->pos;
+	}
+}
+
 void DbfSerializerPutByte(DbfSerializer *dbfSerializer, char b)
 {
+	DbfSerializerCrcUpdate(dbfSerializer);
+
 //#if defined __linux__ || defined __WIN32
 //	assert(dbfSerializer->debugState == 0);
 //#endif
 
-	if (dbfSerializer->pos<sizeof(dbfSerializer->buffer))
+	if (dbfSerializer->pos<dbfSerializer->capacity)
 	{
 		dbfSerializer->buffer[dbfSerializer->pos] = b;
 		dbfSerializer->pos++;
@@ -282,9 +380,35 @@ void DbfSerializerPutByte(DbfSerializer *dbfSerializer, char b)
 	else
 	{
 		dbfDebugLog("DbfSerializerPutByte full");
+		dbfSerializer->overflow = 1;
+	}
+}
+
+
+/**
+ * Number of bytes needed to encode d, that is the start sub code
+ * (holding n data bits) and the extension sub codes (7 bits each).
+ * Count leading zeros is a single instruction on Cortex-M4.
+ */
+static inline unsigned int DbfSerializerEncodedLength32(unsigned int n, uint32_t d)
+{
+	if ((d >> n) == 0)
+	{
+		return 1;
 	}
+	const unsigned int nOfBits = 32 - __builtin_clz(d);
+	return 1 + (nOfBits - n + (DBF_EXT_DATANBITS - 1)) / DBF_EXT_DATANBITS;
 }
 
+static inline unsigned int DbfSerializerEncodedLength64(unsigned int n, uint64_t d)
+{
+	if ((d >> n) == 0)
+	{
+		return 1;
+	}
+	const unsigned int nOfBits = 64 - __builtin_clzll(d);
+	return 1 + (nOfBits - n + (DBF_EXT_DATANBITS - 1)) / DBF_EXT_DATANBITS;
+}
 
 /**
  * Parameters:
@@ -292,19 +416,33 @@ void DbfSerializerPutByte(DbfSerializer *dbfSerializer, char b)
  * c: Tells the type of data to be written.
  * n: The number of data bits that will fit in one byte together with c.
  * d: The actual data
+ *
+ * The length of the code is calculated first so that there is only one
+ * check for buffer space per code. If it does not fit nothing is written.
  */
 static void DbfSerializerEncodeData32(DbfSerializer *dbfSerializer, unsigned int c, unsigned int n, uint32_t d)
 {
-	const unsigned int m = (1<<n)-1; // mask for data to be written together with format code.
+	DbfSerializerCrcUpdate(dbfSerializer);
+
+	const unsigned int len = DbfSerializerEncodedLength32(n, d);
+	if (dbfSerializer->pos + len > dbfSerializer->capacity)
+	{
+		dbfDebugLog("DbfSerializerPutByte full");
+		dbfSerializer->overflow = 1;
+		return;
+	}
+
+	char *ptr = &dbfSerializer->buffer[dbfSerializer->pos];
+	dbfSerializer->pos += len;
 
 	// Send the type of code part and as many bits as will fit in first byte.
-	DbfSerializerPutByte(dbfSerializer, c + (d & m));
+	*ptr++ = c + (d & ((1U << n) - 1));
 	d = d >> n;
 
-	// Then as many extension sub codes as needed for the more significant bits.
-	while (d > 0)
+	// Then the extension sub codes for the more significant bits.
+	for(unsigned int i = 1; i < len; i++)
 	{
-		DbfSerializerPutByte(dbfSerializer, DBF_EXT_CODEID + (d & DBF_EXT_DATAMASK));
+		*ptr++ = DBF_EXT_CODEID + (d & DBF_EXT_DATAMASK);
 		d = d >> DBF_EXT_DATANBITS;
 	}
 }
@@ -314,26 +452,51 @@ static void DbfSerializerEncodeData32(DbfSerializer *dbfSerializer, unsigned int
  */
 static void DbfSerializerEncodeData64(DbfSerializer *dbfSerializer, unsigned int c, unsigned int n, uint64_t d)
 {
-	const unsigned int m = (1<<n)-1; // mask for data to be written together with format code.
+	if ((uint32_t)(d >> 32) == 0)
+	{
+		// Most values fit in 32 bits, 64 bit shifts are several instructions on Cortex-M4.
+		DbfSerializerEncodeData32(dbfSerializer, c, n, (uint32_t)d);
+		return;
+	}
 
-	// Send the type of code part and as many bits as will fit in first byte.
-	DbfSerializerPutByte(dbfSerializer, c + (d & m));
+	DbfSerializerCrcUpdate(dbfSerializer);
+
+	const unsigned int len = DbfSerializerEncodedLength64(n, d);
+	if (dbfSerializer->pos + len > dbfSerializer->capacity)
+	{
+		dbfDebugLog("DbfSerializerPutByte full");
+		dbfSerializer->overflow = 1;
+		return;
+	}
+
+	char *ptr = &dbfSerializer->buffer[dbfSerializer->pos];
+	dbfSerializer->pos += len;
+
+	*ptr++ = c + (d & ((1U << n) - 1));
 	d = d >> n;
 
-	// Then as many extension sub codes as needed for the more significant bits.
-	while (d > 0)
+	for(unsigned int i = 1; i < len; i++)
 	{
-		DbfSerializerPutByte(dbfSerializer, DBF_EXT_CODEID + (d & DBF_EXT_DATAMASK));
+		*ptr++ = DBF_EXT_CODEID + (d & DBF_EXT_DATAMASK);
 		d = d >> DBF_EXT_DATANBITS;
 	}
 }
 
 void DbfSerializerWriteCrc(DbfSerializer *dbfSerializer)
 {
-	const uint32_t crc = crc32_calculate((const unsigned char *)dbfSerializer->buffer, dbfSerializer->pos);
+	DbfSerializerCrcUpdate(dbfSerializer);
+	const uint32_t crc = crc32_final(dbfSerializer->crc);
 	DbfSerializerEncodeData32(dbfSerializer, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, crc);
 }
 
+void DbfSerializerWriteTtl(DbfSerializer *dbfSerializer, unsigned int ttl)
+{
+	DbfSerializerEncodeData32(dbfSerializer, DBF_NETOPT_CODEID, DBF_NETOPT_DATANBITS, ttl);
+
+	// Networking options are not included in the CRC.
+	dbfSerializer->crcPos = dbfSerializer->pos;
+}
+
 
 static void DbfSerializerWriteCode16(DbfSerializer *dbfSerializer, int16_t i)
 {
@@ -372,8 +535,43 @@ static void DbfSerializerWriteCode64(DbfSerializer *dbfSerializer, int64_t i)
 }
 
 
+/**
+ * If the integer to write is same as previous one (and nothing else has
+ * been written since) a repetition code is written (or updated) instead.
+ * Returns non zero if that was done.
+ */
+static int DbfSerializerWriteRepeat(DbfSerializer *dbfSerializer, int64_t i)
+{
+	if ((dbfSerializer->encoderState != DBF_ENCODING_INT) || (dbfSerializer->pos == 0) || (i != dbfSerializer->lastValue))
+	{
+		dbfSerializer->repeatCount = 0;
+		dbfSerializer->lastValue = i;
+		return 0;
+	}
+
+	if (dbfSerializer->repeatCount == 0)
+	{
+		dbfSerializer->repeatPos = dbfSerializer->pos;
+	}
+	else
+	{
+		// The repetition code is the last thing in buffer, replace it with one with a higher count.
+		dbfSerializer->pos = dbfSerializer->repeatPos;
+	}
+	dbfSerializer->repeatCount++;
+
+	// A repetition code with n means n+1 extra repetitions.
+	DbfSerializerEncodeData32(dbfSerializer, DBF_SPEC_CODEID, DBF_SPEC_DATANBITS, dbfSerializer->repeatCount - 1);
+	return 1;
+}
+
 void DbfSerializerWriteInt32(DbfSerializer *dbfSerializer, int32_t i)
 {
+	if (DbfSerializerWriteRepeat(dbfSerializer, i))
+	{
+		return;
+	}
+
 	//printf("DbfSerializerWriteInt %d\n", i);
 	// If format is not already numeric then send the code "INT_BEGIN_CODE".
 	switch(dbfSerializer->encoderState)
@@ -402,6 +600,11 @@ void DbfSerializerWriteInt32(DbfSerializer *dbfSerializer, int32_t i)
 
 void DbfSerializerWriteInt64(DbfSerializer *dbfSerializer, int64_t i)
 {
+	if (DbfSerializerWriteRepeat(dbfSerializer, i))
+	{
+		return;
+	}
+
 	//printf("DbfSerializerWriteInt %d\n", i);
 	// If format is not already numeric then send the code "INT_BEGIN_CODE".
 	switch(dbfSerializer->encoderState)
@@ -427,8 +630,116 @@ void DbfSerializerWriteInt64(DbfSerializer *dbfSerializer, int64_t i)
 	DbfSerializerWriteCode64(dbfSerializer, i);
 }
 
+// Words for compact strings, see DBF_CSTR_BEGIN_CODE. Words from
+// messages, file names and SCPI. Only add words at end of this list.
+static const char* const dbfStringDictionary[] = {
+	"EIT ",
+	"Dielectric",
+	" test ",
+	"system",
+	"SCPI",
+	"VOLT",
+	"FUNC",
+	"FETC",
+	"NPLCycles",
+	"KEITHLEY",
+	"INSTRUMENTS",
+	"MODEL",
+	"src/",
+	"sizeof(",
+	"SIZEOF_ARRAY(",
+	"IS_FLASH_",
+	"PROGRAM_ADDRESS",
+	"HAL_OK",
+	"channel",
+	"offset",
+	"nBytes",
+	"dataSize",
+	"flash",
+	"eeprom",
+	" == ",
+	" != ",
+	" <= ",
+	" >= ",
+	" && ",
+	" || ",
+	"error",
+	"Error",
+	"assert",
+	"timeout",
+	"status",
+	"voltage",
+	"current",
+	"temp",
+	"version",
+	"serial",
+	"message",
+	"buffer",
+};
+
+#define DBF_STRING_DICTIONARY_SIZE (sizeof(dbfStringDictionary) / sizeof(dbfStringDictionary[0]))
+
+const char* DbfStringDictionaryGetWord(unsigned int idx)
+{
+	return (idx < DBF_STRING_DICTIONARY_SIZE) ? dbfStringDictionary[idx] : NULL;
+}
+
+// Returns number of characters in str that are same as word or 0 if not all of word is there.
+static unsigned int DbfStringMatchWord(const char *str, const char *word)
+{
+	unsigned int n = 0;
+	while (word[n] != 0)
+	{
+		if (str[n] != word[n])
+		{
+			return 0;
+		}
+		n++;
+	}
+	return n;
+}
+
+void DbfSerializerWriteCompactString(DbfSerializer *dbfSerializer, const char *str)
+{
+	DbfSerializerEncodeData32(dbfSerializer, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_CSTR_BEGIN_CODE);
+	dbfSerializer->encoderState = DBF_ENCODING_STR;
+	while(*str)
+	{
+		// Find the longest word, words shorter than 3 characters give nothing.
+		unsigned int bestLen = 2;
+		unsigned int bestIdx = 0;
+		for(unsigned int w = 0; w < DBF_STRING_DICTIONARY_SIZE; w++)
+		{
+			if (dbfStringDictionary[w][0] == *str)
+			{
+				const unsigned int n = DbfStringMatchWord(str, dbfStringDictionary[w]);
+				if (n > bestLen)
+				{
+					bestLen = n;
+					bestIdx = w;
+				}
+			}
+		}
+
+		if (bestLen > 2)
+		{
+			DbfSerializerEncodeData32(dbfSerializer, DBF_PINT_CODEID, DBF_PINT_DATANBITS, DBF_STRING_DICTIONARY_FIRST + bestIdx);
+			str += bestLen;
+		}
+		else
+		{
+			int i = *str;
+			DbfSerializerWriteCode16(dbfSerializer, i-64);
+			str++;
+		}
+	}
+}
+
 void DbfSerializerWriteString(DbfSerializer *dbfSerializer, const char *str)
 {
+	#ifdef DBF_COMPACT_STRINGS
+	DbfSerializerWriteCompactString(dbfSerializer, str);
+	#else
 	//printf("DbfSerializerWriteString '%s'\n", str);
 	// Send a string format code to tell receiver that it is a string that follows.
 	// It is needed also if previous parameter was a string since this also separates strings.
@@ -441,6 +752,115 @@ void DbfSerializerWriteString(DbfSerializer *dbfSerializer, const char *str)
 		DbfSerializerWriteCode16(dbfSerializer, i-64);
 		str++;
 	}
+	#endif
+}
+
+/**
+ * Removes trailing zeros from mantissa, this is what DbfSerializerWriteDecimal
+ * does before writing so this gives the values the receiver will see.
+ */
+void DbfDecimalNormalize(int64_t *mantissa, int32_t *exponent)
+{
+	if (*mantissa == 0)
+	{
+		*exponent = 0;
+	}
+	else
+	{
+		while (((*mantissa % 10) == 0) && (*exponent < INT32_MAX))
+		{
+			*mantissa /= 10;
+			(*exponent)++;
+		}
+	}
+}
+
+/**
+ * Writes mantissa * 10^exponent, see format code 5.
+ */
+void DbfSerializerWriteDecimal(DbfSerializer *dbfSerializer, int64_t mantissa, int32_t exponent)
+{
+	DbfDecimalNormalize(&mantissa, &exponent);
+
+	if (dbfSerializer->encoderState != DBF_ENCODING_DECIMAL)
+	{
+		DbfSerializerEncodeData32(dbfSerializer, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_DECIMAL_BEGIN_CODE);
+		dbfSerializer->encoderState = DBF_ENCODING_DECIMAL;
+	}
+	DbfSerializerWriteCode64(dbfSerializer, mantissa);
+	DbfSerializerWriteCode32(dbfSerializer, exponent);
+}
+
+/**
+ * Packs elements of elementSize bytes each as a bit stream into extension
+ * sub codes. If it does not fit nothing is written.
+ */
+static void DbfSerializerWriteArray(DbfSerializer *dbfSerializer, const void *ptr, unsigned int elementSize, unsigned int nOfElements)
+{
+	const unsigned int nOfBits = elementSize * 8;
+	const unsigned int nOfDataBytes = (nOfElements * nOfBits + (DBF_EXT_DATANBITS - 1)) / DBF_EXT_DATANBITS;
+	const unsigned int needed = DbfSerializerEncodedLength32(DBF_FMTCRC_DATANBITS, DBF_ARRAY_BEGIN_CODE) +
+			DbfSerializerEncodedLength32(DBF_PINT_DATANBITS, elementSize) +
+			DbfSerializerEncodedLength32(DBF_PINT_DATANBITS, nOfElements) +
+			1 + nOfDataBytes;
+	if (dbfSerializer->pos + needed > dbfSerializer->capacity)
+	{
+		dbfDebugLog("DbfSerializerWriteArray full");
+		dbfSerializer->overflow = 1;
+		return;
+	}
+
+	DbfSerializerEncodeData32(dbfSerializer, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_ARRAY_BEGIN_CODE);
+	DbfSerializerEncodeData32(dbfSerializer, DBF_PINT_CODEID, DBF_PINT_DATANBITS, elementSize);
+	DbfSerializerEncodeData32(dbfSerializer, DBF_PINT_CODEID, DBF_PINT_DATANBITS, nOfElements);
+	DbfSerializerCrcUpdate(dbfSerializer);
+	dbfSerializer->encoderState = DBF_ENCODING_ARRAY;
+
+	char *dst = dbfSerializer->buffer + dbfSerializer->pos;
+	*dst++ = DBF_PINT_CODEID;
+
+	// Bits not yet written are kept in acc, an element is at most 32 bits
+	// and at most 6 bits remain from previous so 64 bits is enough.
+	uint64_t acc = 0;
+	unsigned int nInAcc = 0;
+	for(unsigned int i = 0; i < nOfElements; i++)
+	{
+		uint32_t d;
+		switch(elementSize)
+		{
+			case 1: d = ((const uint8_t*)ptr)[i]; break;
+			case 2: d = (uint16_t)((const int16_t*)ptr)[i]; break;
+			default: d = (uint32_t)((const int32_t*)ptr)[i]; break;
+		}
+		acc |= (uint64_t)d << nInAcc;
+		nInAcc += nOfBits;
+		while (nInAcc >= DBF_EXT_DATANBITS)
+		{
+			*dst++ = DBF_EXT_CODEID | (acc & DBF_EXT_DATAMASK);
+			acc >>= DBF_EXT_DATANBITS;
+			nInAcc -= DBF_EXT_DATANBITS;
+		}
+	}
+	if (nInAcc > 0)
+	{
+		*dst++ = DBF_EXT_CODEID | (acc & DBF_EXT_DATAMASK);
+	}
+	dbfSerializer->pos += 1 + nOfDataBytes;
+}
+
+void DbfSerializerWriteArray8(DbfSerializer *dbfSerializer, const uint8_t *ptr, unsigned int nOfElements)
+{
+	DbfSerializerWriteArray(dbfSerializer, ptr, 1, nOfElements);
+}
+
+void DbfSerializerWriteArray16(DbfSerializer *dbfSerializer, const int16_t *ptr, unsigned int nOfElements)
+{
+	DbfSerializerWriteArray(dbfSerializer, ptr, 2, nOfElements);
+}
+
+void DbfSerializerWriteArray32(DbfSerializer *dbfSerializer, const int32_t *ptr, unsigned int nOfElements)
+{
+	DbfSerializerWriteArray(dbfSerializer, ptr, 4, nOfElements);
 }
 
 const char* DbfSerializerGetMsgPtr(const DbfSerializer *dbfSerializer)
@@ -519,15 +939,36 @@ static uint8_t GET_CODE_TYPE(uint8_t i)
 */
 
 
+/**
+ * Networking options (000001bb and 0000001b) in the beginning of a message
+ * are not part of the message body. Returns where the body begins.
+ */
+static unsigned int DbfFindBodyPos(const unsigned char *msgPtr, unsigned int msgSize)
+{
+	unsigned int idx = 0;
+	while ((idx < msgSize) && (msgPtr[idx] > DBF_END_CODEID) && (msgPtr[idx] < DBF_SPEC_CODEID))
+	{
+		idx++;
+		while ((idx < msgSize) && ((msgPtr[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+		{
+			idx++;
+		}
+	}
+	return idx;
+}
+
 /**
  * Returns DBF_OK_CRC if OK. A non zero error code if not OK (there was a CRC error).
  */
 DBF_CRC_RESULT DbfUnserializerInit(DbfUnserializer *dbfUnserializer, const unsigned char *msgPtr, unsigned int msgSize)
 {
-	dbfUnserializer->msgPtr = msgPtr;
-	dbfUnserializer->msgSize = msgSize;
+	const unsigned int bodyPos = DbfFindBodyPos(msgPtr, msgSize);
+	dbfUnserializer->msgPtr = msgPtr + bodyPos;
+	dbfUnserializer->msgSize = msgSize - bodyPos;
 	dbfUnserializer->decodeState = DbfIntegerCodeState;
 	dbfUnserializer->readPos = 0;
+	dbfUnserializer->repeatPos = -1;
+	dbfUnserializer->repeatCount = 0;
 
 	DBF_CRC_RESULT r = DbfUnserializerReadCrc(dbfUnserializer);
 	switch(r)
@@ -612,14 +1053,14 @@ DbfCodeTypesEnum DbfUnserializerGetNextType(const DbfUnserializer *dbfUnserializ
 
 // The code is decoded backwards, from its end to its beginning.
 // codeEndIndex shall be the index of the first character in next code.
-static int32_t DbfUnserializerDecodeData32(const DbfUnserializer *dbfUnserializer, int codeEndIndex)
+static int64_t DbfUnserializerDecodeData64(const DbfUnserializer *dbfUnserializer, int codeEndIndex)
 {
-	int32_t i = 0;
+	int64_t i = 0;
 
 	while (codeEndIndex>0)
 	{
 		codeEndIndex--;
-		unsigned char ch = dbfUnserializer->msgPtr[codeEndIndex];
+		const unsigned char ch = dbfUnserializer->msgPtr[codeEndIndex];
 
 		const /*DbfCodeTypesEnum*/ uint8_t ct = GET_CODE_TYPE(ch);
 
@@ -643,7 +1084,7 @@ static int32_t DbfUnserializerDecodeData32(const DbfUnserializer *dbfUnserialize
 				return i;
 			default:
 				#if defined __linux__ || defined __WIN32
-				printf("Unknown code 0x%x\n", ch);
+				printf("Unknown code 0x%x\n", (int)ch);
 				#endif
 				return 0;
 		}
@@ -651,45 +1092,85 @@ static int32_t DbfUnserializerDecodeData32(const DbfUnserializer *dbfUnserialize
 	return i;
 }
 
-// The code is decoded backwards, from its end to its beginning.
-// codeEndIndex shall be the index of the first character in next code.
-static int64_t DbfUnserializerDecodeData64(const DbfUnserializer *dbfUnserializer, int codeEndIndex)
+// The code is decoded forward, from its beginning to its end, reading each
+// byte only once. This is what the Read functions use, decoding backwards
+// (as above) is only needed when the end of a code is known but not its
+// beginning, such as when taking the CRC at end of message.
+// idx shall be the index of the first character in the code,
+// end is the size of the message (or where decoding shall stop).
+// Returns the index of the first character in next code.
+static unsigned int DbfDecodeFwd32(const unsigned char *ptr, unsigned int idx, unsigned int end, int32_t *result)
 {
-	int64_t i = 0;
+	const unsigned char ch = ptr[idx++];
+	uint32_t d;
+	unsigned int n;
+	int isNegative = 0;
 
-	while (codeEndIndex>0)
+	switch (GET_CODE_TYPE(ch))
 	{
-		codeEndIndex--;
-		const unsigned char ch = dbfUnserializer->msgPtr[codeEndIndex];
+		case DbfINT: d = ch & DBF_PINT_DATAMASK; n = DBF_PINT_DATANBITS; break;
+		case DbfNEG: d = ch & DBF_NINT_DATAMASK; n = DBF_NINT_DATANBITS; isNegative = 1; break;
+		case DbfCRC: d = ch & DBF_FMTCRC_DATAMASK; n = DBF_FMTCRC_DATANBITS; break;
+		case DbfSCT: d = ch & DBF_SPEC_DATAMASK; n = DBF_SPEC_DATANBITS; break;
+		case DbfEXT: d = ch & DBF_EXT_DATAMASK; n = DBF_EXT_DATANBITS; break;
+		default:
+			#if defined __linux__ || defined __WIN32
+			printf("Unknown code 0x%x\n", ch);
+			#endif
+			*result = 0;
+			return idx;
+	}
 
-		const /*DbfCodeTypesEnum*/ uint8_t ct = GET_CODE_TYPE(ch);
+	// Then the extension sub codes, least significant first.
+	while ((idx < end) && ((ptr[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+	{
+		if (n < 32)
+		{
+			d |= (uint32_t)(ptr[idx] & DBF_EXT_DATAMASK) << n;
+		}
+		n += DBF_EXT_DATANBITS;
+		idx++;
+	}
 
-		switch (ct)
+	*result = isNegative ? (int32_t)(-1 - (int32_t)d) : (int32_t)d;
+	return idx;
+}
+
+// Same as DbfDecodeFwd32 but for 64 bit values.
+static unsigned int DbfDecodeFwd64(const unsigned char *ptr, unsigned int idx, unsigned int end, int64_t *result)
+{
+	const unsigned char ch = ptr[idx++];
+	uint64_t d;
+	unsigned int n;
+	int isNegative = 0;
+
+	switch (GET_CODE_TYPE(ch))
+	{
+		case DbfINT: d = ch & DBF_PINT_DATAMASK; n = DBF_PINT_DATANBITS; break;
+		case DbfNEG: d = ch & DBF_NINT_DATAMASK; n = DBF_NINT_DATANBITS; isNegative = 1; break;
+		case DbfCRC: d = ch & DBF_FMTCRC_DATAMASK; n = DBF_FMTCRC_DATANBITS; break;
+		case DbfSCT: d = ch & DBF_SPEC_DATAMASK; n = DBF_SPEC_DATANBITS; break;
+		case DbfEXT: d = ch & DBF_EXT_DATAMASK; n = DBF_EXT_DATANBITS; break;
+		default:
+			#if defined __linux__ || defined __WIN32
+			printf("Unknown code 0x%x\n", (int)ch);
+			#endif
+			*result = 0;
+			return idx;
+	}
+
+	while ((idx < end) && ((ptr[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+	{
+		if (n < 64)
 		{
-			case DbfEXT:
-				i = (i << DBF_EXT_DATANBITS) | (ch & DBF_EXT_DATAMASK);
-				break;
-			case DbfINT:
-				i = (i << DBF_PINT_DATANBITS) | (ch & DBF_PINT_DATAMASK);
-				return i;
-			case DbfNEG:
-				i = (i << DBF_NINT_DATANBITS) | (ch & DBF_NINT_DATAMASK);
-				i = -1 - i;
-				return i;
-			case DbfCRC:
-				i = (i << DBF_FMTCRC_DATANBITS) | (ch & DBF_FMTCRC_DATAMASK);
-				return i;
-			case DbfSCT:
-				i = (i << DBF_SPEC_DATANBITS) | (ch & DBF_SPEC_DATAMASK);
-				return i;
-			default:
-				#if defined __linux__ || defined __WIN32
-				printf("Unknown code 0x%x\n", (int)ch);
-				#endif
-				return 0;
+			d |= (uint64_t)(ptr[idx] & DBF_EXT_DATAMASK) << n;
 		}
+		n += DBF_EXT_DATANBITS;
+		idx++;
 	}
-	return i;
+
+	*result = isNegative ? (int64_t)(-1 - (int64_t)d) : (int64_t)d;
+	return idx;
 }
 
 /**
@@ -714,6 +1195,9 @@ static DbfCodeStateEnum DbfUnserializerEvaluateSpecCode(int c)
 	{
 		case DBF_INT_BEGIN_CODE: return DbfIntegerCodeState;
 		case DBF_STR_BEGIN_CODE: return DbfStringCodeState;
+		case DBF_CSTR_BEGIN_CODE: return DbfCompactStringCodeState;
+		case DBF_ARRAY_BEGIN_CODE: return DbfArrayCodeState;
+		case DBF_DECIMAL_BEGIN_CODE: return DbfDecimalCodeState;
 		default: return DbfInitialCodeState;
 	}
 }
@@ -724,18 +1208,33 @@ static DbfCodeStateEnum DbfUnserializerEvaluateSpecCode(int c)
  */
 static void DbfUnserializerReadSpecial(DbfUnserializer *dbfUnserializer)
 {
+	if (dbfUnserializer->repeatCount > 0)
+	{
+		// There are repeated numbers still to be read.
+		return;
+	}
+
 	const DbfCodeTypesEnum t = DbfUnserializerGetNextType(dbfUnserializer, dbfUnserializer->readPos);
 
 	switch(t)
 	{
-		case DbfCRC:
 		case DbfSCT:
+			if (dbfUnserializer->repeatPos >= 0)
+			{
+				// This is a repetition code, previous number shall be given n+1 more times.
+				int32_t n;
+				dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &n);
+				dbfUnserializer->repeatCount = n + 1;
+				break;
+			}
+			// fall through
+		case DbfCRC:
 		{
 			// This was a format code.
-			unsigned int nextIndex = DbfUnserializerFindNextCode(dbfUnserializer, dbfUnserializer->readPos);
-			int64_t specialCode = DbfUnserializerDecodeData64(dbfUnserializer, nextIndex);
+			int32_t specialCode;
+			dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &specialCode);
 			dbfUnserializer->decodeState = DbfUnserializerEvaluateSpecCode(specialCode);
-			dbfUnserializer->readPos = nextIndex;
+			dbfUnserializer->repeatPos = -1;
 			break;
 		}
 		case DbfEMC:
@@ -762,13 +1261,19 @@ int32_t DbfUnserializerReadInt32(DbfUnserializer *dbfUnserializer)
 	// Read and skip next code if it is a special code for message formating etc.
 	DbfUnserializerReadSpecial(dbfUnserializer);
 
-	const unsigned int nextCodeIndex = DbfUnserializerFindNextCode(dbfUnserializer, dbfUnserializer->readPos);
-	if (nextCodeIndex > dbfUnserializer->msgSize)
+	int32_t i;
+	if (dbfUnserializer->repeatCount > 0)
+	{
+		DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->repeatPos, dbfUnserializer->msgSize, &i);
+		dbfUnserializer->repeatCount--;
+		return i;
+	}
+	if (dbfUnserializer->readPos >= dbfUnserializer->msgSize)
 	{
 		return 0;
 	}
-	const int32_t i = DbfUnserializerDecodeData32(dbfUnserializer, nextCodeIndex);
-	dbfUnserializer->readPos = nextCodeIndex;
+	dbfUnserializer->repeatPos = dbfUnserializer->readPos;
+	dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &i);
 	return i;
 }
 
@@ -777,50 +1282,181 @@ int64_t DbfUnserializerReadInt64(DbfUnserializer *dbfUnserializer)
 	// Read and skip next code if it is a special code for message formating etc.
 	DbfUnserializerReadSpecial(dbfUnserializer);
 
-	const unsigned int nextCodeIndex = DbfUnserializerFindNextCode(dbfUnserializer, dbfUnserializer->readPos);
-	if (nextCodeIndex > dbfUnserializer->msgSize)
+	int64_t i;
+	if (dbfUnserializer->repeatCount > 0)
+	{
+		DbfDecodeFwd64(dbfUnserializer->msgPtr, dbfUnserializer->repeatPos, dbfUnserializer->msgSize, &i);
+		dbfUnserializer->repeatCount--;
+		return i;
+	}
+	if (dbfUnserializer->readPos >= dbfUnserializer->msgSize)
 	{
 		return 0;
 	}
-	const int64_t i = DbfUnserializerDecodeData64(dbfUnserializer, nextCodeIndex);
-	dbfUnserializer->readPos = nextCodeIndex;
+	dbfUnserializer->repeatPos = dbfUnserializer->readPos;
+	dbfUnserializer->readPos = DbfDecodeFwd64(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &i);
 	return i;
 }
 
 
-int DbfUnserializerReadString(DbfUnserializer *dbfUnserializer, char* bufPtr, int bufLen)
+// Puts the character (or for compact strings the word) that code i represents
+// in buffer. Returns number of characters put.
+static int DbfUnserializerPutStringCode(const DbfUnserializer *dbfUnserializer, int32_t i, char* bufPtr, int bufLen)
 {
-	// Read and skip next code if it is a special code for message formating etc.
-	DbfUnserializerReadSpecial(dbfUnserializer);
-
+	if ((i < DBF_STRING_DICTIONARY_FIRST) || (dbfUnserializer->decodeState != DbfCompactStringCodeState))
+	{
+		*bufPtr = i+64;
+		return 1;
+	}
+	const char *word = DbfStringDictionaryGetWord(i - DBF_STRING_DICTIONARY_FIRST);
+	if (word == NULL)
+	{
+		word = "?";
+	}
 	int n = 0;
-	while(n<(bufLen-1))
+	while ((word[n] != 0) && (n < bufLen))
+	{
+		bufPtr[n] = word[n];
+		n++;
+	}
+	return n;
+}
+
+int DbfUnserializerReadString(DbfUnserializer *dbfUnserializer, char* bufPtr, int bufLen)
+{
+	// Read and skip next code if it is a special code for message formating etc.
+	DbfUnserializerReadSpecial(dbfUnserializer);
+
+	int n = 0;
+	while(n<(bufLen-1))
 	{
 		// Read as long as it is a code that represents characters (that is positive or negative numbers)
 		int t = DbfUnserializerGetNextType(dbfUnserializer, dbfUnserializer->readPos);
-		if ((t == DbfINT) || (t == DbfNEG))
+		if (dbfUnserializer->repeatCount > 0)
 		{
-			unsigned int e = DbfUnserializerFindNextCode(dbfUnserializer, dbfUnserializer->readPos);
-			int i = DbfUnserializerDecodeData32(dbfUnserializer, e);
-			*bufPtr++ = i+64;
-			n++;
-			dbfUnserializer->readPos = e;
+			int32_t i;
+			DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->repeatPos, dbfUnserializer->msgSize, &i);
+			dbfUnserializer->repeatCount--;
+			n += DbfUnserializerPutStringCode(dbfUnserializer, i, bufPtr+n, bufLen-1-n);
+		}
+		else if ((t == DbfINT) || (t == DbfNEG))
+		{
+			int32_t i;
+			dbfUnserializer->repeatPos = dbfUnserializer->readPos;
+			dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &i);
+			n += DbfUnserializerPutStringCode(dbfUnserializer, i, bufPtr+n, bufLen-1-n);
+		}
+		else if ((t == DbfSCT) && (dbfUnserializer->repeatPos >= 0))
+		{
+			// Repeated character.
+			DbfUnserializerReadSpecial(dbfUnserializer);
 		}
 		else
 		{
 			// Any other code means the string has ended.
-			// Perhaps we want to have a special code for repeated characters?
-			// If so something more is needed here.
 			break;
 		}
 	}
-	*bufPtr = 0;
+	bufPtr[n] = 0;
 	return n;
 }
 
+/**
+ * Reads an array written by one of the DbfSerializerWriteArray functions.
+ * Nothing is copied, dbfArray will refer to the data in the message buffer
+ * so the message buffer must be kept until done with dbfArray.
+ * Returns number of elements or -1 if next code was not a valid array.
+ */
+int DbfUnserializerReadArray(DbfUnserializer *dbfUnserializer, DbfArray *dbfArray)
+{
+	DbfUnserializerReadSpecial(dbfUnserializer);
+
+	dbfArray->ptr = NULL;
+	dbfArray->elementSize = 0;
+	dbfArray->nOfElements = 0;
+
+	if ((dbfUnserializer->decodeState != DbfArrayCodeState) || (dbfUnserializer->readPos >= dbfUnserializer->msgSize))
+	{
+		return -1;
+	}
+
+	int32_t elementSize;
+	int32_t nOfElements;
+	dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &elementSize);
+	if (dbfUnserializer->readPos >= dbfUnserializer->msgSize)
+	{
+		return -1;
+	}
+	dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, &nOfElements);
+	if (dbfUnserializer->readPos >= dbfUnserializer->msgSize)
+	{
+		return -1;
+	}
+
+	// The data code, first the start sub code and then the data in extension sub codes.
+	const unsigned int begin = dbfUnserializer->readPos + 1;
+	unsigned int end = begin;
+	while ((end < dbfUnserializer->msgSize) && ((dbfUnserializer->msgPtr[end] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+	{
+		end++;
+	}
+	dbfUnserializer->readPos = end;
+	dbfUnserializer->repeatPos = -1;
+
+	if (((elementSize != 1) && (elementSize != 2) && (elementSize != 4)) ||
+		(nOfElements < 0) ||
+		((uint64_t)nOfElements * elementSize * 8 > (end - begin) * DBF_EXT_DATANBITS))
+	{
+		return -1;
+	}
+
+	dbfArray->ptr = dbfUnserializer->msgPtr + begin;
+	dbfArray->elementSize = elementSize;
+	dbfArray->nOfElements = nOfElements;
+	return nOfElements;
+}
+
+/**
+ * Reads a decimal number written by DbfSerializerWriteDecimal.
+ * The value is mantissa * 10^exponent.
+ * Returns 0 if OK, -1 if next code was not a decimal number.
+ */
+int DbfUnserializerReadDecimal(DbfUnserializer *dbfUnserializer, int64_t *mantissa, int32_t *exponent)
+{
+	DbfUnserializerReadSpecial(dbfUnserializer);
+
+	if ((dbfUnserializer->decodeState != DbfDecimalCodeState) || (dbfUnserializer->readPos >= dbfUnserializer->msgSize))
+	{
+		*mantissa = 0;
+		*exponent = 0;
+		return -1;
+	}
+
+	dbfUnserializer->readPos = DbfDecodeFwd64(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, mantissa);
+	if (dbfUnserializer->readPos >= dbfUnserializer->msgSize)
+	{
+		*exponent = 0;
+		return -1;
+	}
+	dbfUnserializer->readPos = DbfDecodeFwd32(dbfUnserializer->msgPtr, dbfUnserializer->readPos, dbfUnserializer->msgSize, exponent);
+	dbfUnserializer->repeatPos = -1;
+	return 0;
+}
+
+int DbfUnserializerReadIsNextDecimal(DbfUnserializer *dbfUnserializer)
+{
+	return (DbfUnserializerReadCodeState(dbfUnserializer) == DbfDecimalCodeState);
+}
+
+int DbfUnserializerReadIsNextArray(DbfUnserializer *dbfUnserializer)
+{
+	return (DbfUnserializerReadCodeState(dbfUnserializer) == DbfArrayCodeState);
+}
+
 int DbfUnserializerReadIsNextString(DbfUnserializer *dbfUnserializer)
 {
-	return (DbfUnserializerReadCodeState(dbfUnserializer) == DbfStringCodeState);
+	const DbfCodeStateEnum state = DbfUnserializerReadCodeState(dbfUnserializer);
+	return ((state == DbfStringCodeState) || (state == DbfCompactStringCodeState));
 }
 
 int DbfUnserializerReadIsNextInt(DbfUnserializer *dbfUnserializer)
@@ -830,6 +1466,10 @@ int DbfUnserializerReadIsNextInt(DbfUnserializer *dbfUnserializer)
 
 int DbfUnserializerReadIsNextEnd(DbfUnserializer *dbfUnserializer)
 {
+	if (dbfUnserializer->repeatCount > 0)
+	{
+		return 0;
+	}
 	if (dbfUnserializer->readPos>=dbfUnserializer->msgSize)
 	{
 		return 1;
@@ -880,6 +1520,190 @@ DBF_CRC_RESULT DbfUnserializerReadCrc(DbfUnserializer *dbfUnserializer)
 
 
 
+/**
+ * Scan a message once and store where each code begins and its type.
+ * Typically msgPtr and msgSize are taken from a DbfUnserializer after
+ * DbfUnserializerInit so that the CRC is not included.
+ * Returns the number of codes indexed or -1 if there were more codes
+ * than DBF_FIELD_INDEX_SIZE entries can hold (then only the first ones
+ * are indexed).
+ * Repetition codes are expanded, the repeated number is counted (and
+ * given) as many times as DbfUnserializer would give it.
+ */
+int DbfFieldIndexInit(DbfFieldIndex *dbfFieldIndex, const unsigned char *msgPtr, unsigned int msgSize)
+{
+	unsigned int n = 0;
+	unsigned int nOfCodes = 0;
+	unsigned int idx = 0;
+
+	dbfFieldIndex->msgPtr = msgPtr;
+
+	while (idx < msgSize)
+	{
+		const unsigned int begin = idx;
+		const uint8_t type = GET_CODE_TYPE(msgPtr[idx]);
+
+		// Skip the extension sub codes belonging to this code.
+		idx++;
+		while ((idx < msgSize) && ((msgPtr[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+		{
+			idx++;
+		}
+
+		if ((type == DbfSCT) && (n > 0) && ((dbfFieldIndex->codes[n - 1].type == DbfINT) || (dbfFieldIndex->codes[n - 1].type == DbfNEG)))
+		{
+			// Repetition code, previous number is given n+1 more times.
+			int32_t r;
+			DbfDecodeFwd32(msgPtr, begin, idx, &r);
+			if ((r < 0) || ((uint32_t)r + 1 > UINT16_MAX - nOfCodes))
+			{
+				// More than can be numbered in an entry.
+				dbfFieldIndex->nOfCodes = nOfCodes;
+				dbfFieldIndex->nOfEntries = n;
+				return -1;
+			}
+			dbfFieldIndex->codes[n - 1].repeatCount += r + 1;
+			nOfCodes += r + 1;
+			continue;
+		}
+
+		if (n >= DBF_FIELD_INDEX_SIZE)
+		{
+			dbfFieldIndex->nOfCodes = nOfCodes;
+			dbfFieldIndex->nOfEntries = n;
+			return -1;
+		}
+
+		DbfFieldIndexEntry *e = &dbfFieldIndex->codes[n];
+		e->type = type;
+		e->offset = begin;
+		e->length = idx - begin;
+		e->first = nOfCodes;
+		e->repeatCount = 0;
+		n++;
+		nOfCodes++;
+	}
+
+	dbfFieldIndex->nOfCodes = nOfCodes;
+	dbfFieldIndex->nOfEntries = n;
+	return nOfCodes;
+}
+
+// The entry that gives code i, NULL if there is none.
+static const DbfFieldIndexEntry* DbfFieldIndexFind(const DbfFieldIndex *dbfFieldIndex, unsigned int i)
+{
+	if (i >= dbfFieldIndex->nOfCodes)
+	{
+		return NULL;
+	}
+	if (dbfFieldIndex->nOfCodes == dbfFieldIndex->nOfEntries)
+	{
+		// Nothing repeated, code i is entry i.
+		return &dbfFieldIndex->codes[i];
+	}
+
+	// Last entry that begins at or before code i.
+	unsigned int low = 0;
+	unsigned int high = dbfFieldIndex->nOfEntries - 1;
+	while (low < high)
+	{
+		const unsigned int mid = (low + high + 1) / 2;
+		if (dbfFieldIndex->codes[mid].first <= i)
+		{
+			low = mid;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return &dbfFieldIndex->codes[low];
+}
+
+unsigned int DbfFieldIndexGetNOfCodes(const DbfFieldIndex *dbfFieldIndex)
+{
+	return dbfFieldIndex->nOfCodes;
+}
+
+DbfCodeTypesEnum DbfFieldIndexGetType(const DbfFieldIndex *dbfFieldIndex, unsigned int i)
+{
+	const DbfFieldIndexEntry *e = DbfFieldIndexFind(dbfFieldIndex, i);
+	if (e == NULL)
+	{
+		return DbfEMC;
+	}
+	return e->type;
+}
+
+int32_t DbfFieldIndexGetInt32(const DbfFieldIndex *dbfFieldIndex, unsigned int i)
+{
+	const DbfFieldIndexEntry *e = DbfFieldIndexFind(dbfFieldIndex, i);
+	if (e == NULL)
+	{
+		return 0;
+	}
+	int32_t r;
+	DbfDecodeFwd32(dbfFieldIndex->msgPtr, e->offset, e->offset + e->length, &r);
+	return r;
+}
+
+int64_t DbfFieldIndexGetInt64(const DbfFieldIndex *dbfFieldIndex, unsigned int i)
+{
+	const DbfFieldIndexEntry *e = DbfFieldIndexFind(dbfFieldIndex, i);
+	if (e == NULL)
+	{
+		return 0;
+	}
+	int64_t r;
+	DbfDecodeFwd64(dbfFieldIndex->msgPtr, e->offset, e->offset + e->length, &r);
+	return r;
+}
+
+
+/**
+ * Get element i from the bit stream, 7 bits are stored per byte.
+ */
+static uint32_t DbfArrayGetBits(const DbfArray *dbfArray, unsigned int i)
+{
+	const unsigned int nOfBits = dbfArray->elementSize * 8;
+	unsigned int bitPos = i * nOfBits;
+	uint32_t d = 0;
+	unsigned int n = 0;
+	while (n < nOfBits)
+	{
+		const unsigned int shift = bitPos % DBF_EXT_DATANBITS;
+		const uint32_t b = (dbfArray->ptr[bitPos / DBF_EXT_DATANBITS] & DBF_EXT_DATAMASK) >> shift;
+		d |= b << n;
+		n += DBF_EXT_DATANBITS - shift;
+		bitPos += DBF_EXT_DATANBITS - shift;
+	}
+	if (nOfBits < 32)
+	{
+		d &= (1UL << nOfBits) - 1;
+	}
+	return d;
+}
+
+unsigned int DbfArrayGetNOfElements(const DbfArray *dbfArray)
+{
+	return dbfArray->nOfElements;
+}
+
+uint8_t DbfArrayGetUint8(const DbfArray *dbfArray, unsigned int i)
+{
+	return (i < dbfArray->nOfElements) ? DbfArrayGetBits(dbfArray, i) : 0;
+}
+
+int16_t DbfArrayGetInt16(const DbfArray *dbfArray, unsigned int i)
+{
+	return (i < dbfArray->nOfElements) ? (int16_t)DbfArrayGetBits(dbfArray, i) : 0;
+}
+
+int32_t DbfArrayGetInt32(const DbfArray *dbfArray, unsigned int i)
+{
+	return (i < dbfArray->nOfElements) ? (int32_t)DbfArrayGetBits(dbfArray, i) : 0;
+}
+
 
 static int8_t DbfReceiverIsFull(DbfReceiver * dbfReceiver)
 {
@@ -902,6 +1726,116 @@ static int8_t DbfReceiverStoreByte(DbfReceiver * dbfReceiver, char b)
 
 
 
+// Called when a new DBF message begins.
+static void DbfReceiverCrcInit(DbfReceiver * dbfReceiver)
+{
+	dbfReceiver->crc = crc32_init();
+	dbfReceiver->crcBeforeCode = dbfReceiver->crc;
+	dbfReceiver->codePos = 0;
+	dbfReceiver->crcResult = DBF_NO_CRC;
+	dbfReceiver->bodyPos = 0;
+	dbfReceiver->validResult = DBF_NOT_VALIDATED;
+}
+
+// Called for each byte of a DBF message, pos is where in buffer it is stored.
+static inline void DbfReceiverCrcUpdate(DbfReceiver * dbfReceiver, unsigned char ch, unsigned int pos)
+{
+	if (pos == dbfReceiver->bodyPos)
+	{
+		// Still in the beginning of message, networking options (and their
+		// extension codes) are not part of the CRC. Begin and end codes
+		// never get here so ch below DBF_SPEC_CODEID is a networking option.
+		if ((ch < DBF_SPEC_CODEID) || ((pos != 0) && ((ch & DBF_EXT_CODEMASK) == DBF_EXT_CODEID)))
+		{
+			dbfReceiver->bodyPos = pos + 1;
+			return;
+		}
+	}
+	if ((ch & DBF_EXT_CODEMASK) != DBF_EXT_CODEID)
+	{
+		// A new code begins, it might be the last one (the CRC).
+		dbfReceiver->crcBeforeCode = dbfReceiver->crc;
+		dbfReceiver->codePos = pos;
+	}
+	dbfReceiver->crc = crc32_update_byte(dbfReceiver->crc, ch);
+}
+
+// Called when a DBF message is complete. The last code shall be the CRC.
+static void DbfReceiverCrcEvaluate(DbfReceiver * dbfReceiver)
+{
+	if ((dbfReceiver->codePos >= dbfReceiver->msgSize) || (GET_CODE_TYPE(dbfReceiver->buffer[dbfReceiver->codePos]) != DbfCRC))
+	{
+		dbfReceiver->crcResult = DBF_NO_CRC;
+		return;
+	}
+	int32_t receivedCrc;
+	DbfDecodeFwd32(dbfReceiver->buffer, dbfReceiver->codePos, dbfReceiver->msgSize, &receivedCrc);
+	dbfReceiver->crcResult = ((uint32_t)receivedCrc == crc32_final(dbfReceiver->crcBeforeCode)) ? DBF_OK_CRC : DBF_BAD_CRC;
+}
+
+
+/**
+ * Check the message in one scan without decoding it. Codes are checked for
+ * being allowed where they are, not what they mean. The CRC code itself is
+ * not scanned, it was checked by DbfReceiverCrcEvaluate.
+ */
+static DBF_VALIDATE_RESULT DbfReceiverValidate(const DbfReceiver * dbfReceiver)
+{
+	if (dbfReceiver->crcResult != DBF_OK_CRC)
+	{
+		return DBF_INVALID_CRC;
+	}
+	if (dbfReceiver->msgSize - dbfReceiver->bodyPos > DBF_MAX_BODY_SIZE)
+	{
+		return DBF_INVALID_SIZE;
+	}
+
+	// Start sub code and type of current code, zero until first code.
+	unsigned char startCode = 0;
+	uint8_t startType = DbfNCT;
+	unsigned int nOfExt = 0;
+	for(unsigned int i = dbfReceiver->bodyPos; i < dbfReceiver->codePos; i++)
+	{
+		const unsigned char ch = dbfReceiver->buffer[i];
+		const uint8_t t = GET_CODE_TYPE(ch);
+		switch(t)
+		{
+			case DbfEXT:
+				nOfExt++;
+				if (startCode == 0)
+				{
+					// Extension code without a start sub code.
+					return DBF_INVALID_CODE;
+				}
+				if ((nOfExt > DBF_MAX_EXT_CODES) && (startCode != DBF_PINT_CODEID))
+				{
+					return DBF_INVALID_CODE;
+				}
+				continue;
+			case DbfNCT:
+				// Networking options inside a message, only optional ones may be ignored.
+				if ((ch & ~DBF_NETOPT_DATAMASK) != DBF_NETOPT_CODEID)
+				{
+					return DBF_INVALID_CODE;
+				}
+				break;
+			case DbfSCT:
+				// Version code if first in message, otherwise it must repeat a number.
+				if ((startCode != 0) && (startType != DbfINT) && (startType != DbfNEG))
+				{
+					return DBF_INVALID_CODE;
+				}
+				break;
+			default:
+				break;
+		}
+		startType = t;
+		startCode = ch;
+		nOfExt = 0;
+	}
+	return DBF_VALID;
+}
+
 void DbfReceiverInit(DbfReceiver *dbfReceiver)
 {
 	//dbfDebugLog("DbfReceiverInit");
@@ -915,6 +1849,7 @@ void DbfReceiverInit(DbfReceiver *dbfReceiver)
 	dbfReceiver->msgSize = 0;
 	dbfReceiver->receiverState = DbfRcvInitialState;
 	dbfReceiver->timeoutCounter = 0;
+	DbfReceiverCrcInit(dbfReceiver);
 }
 
 
@@ -941,6 +1876,7 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 				case DBF_BEGIN_CODEID:
 					// A DBF message begin.
 					dbfReceiver->msgSize = 0;
+					DbfReceiverCrcInit(dbfReceiver);
 					dbfReceiver->timeoutCounter = 0;
 					dbfReceiver->receiverState = DbfRcvReceivingMessageState;
 					#if defined __linux__ || defined __WIN32
@@ -997,6 +1933,7 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 					// Ascii lines are expected to end with CR or LF.
 					dbfDebugLog("DBF inside txt");
 					dbfReceiver->msgSize = 0;
+					DbfReceiverCrcInit(dbfReceiver);
 					dbfReceiver->receiverState = DbfRcvReceivingMessageState;
 					dbfReceiver->timeoutCounter = 0;
 					break;
@@ -1039,6 +1976,8 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 					else
 					{
 						dbfReceiver->receiverState = DbfRcvDbfReceivedMoreExpectedState;
+						DbfReceiverCrcEvaluate(dbfReceiver);
+						dbfReceiver->validResult = DbfReceiverValidate(dbfReceiver);
 						//dbfDebugLog("dbf end and begin");
 						return dbfReceiver->msgSize;
 					}
@@ -1053,6 +1992,8 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 					else
 					{
 						dbfReceiver->receiverState = DbfRcvDbfReceivedState;
+						DbfReceiverCrcEvaluate(dbfReceiver);
+						dbfReceiver->validResult = DbfReceiverValidate(dbfReceiver);
 						//dbfDebugLog("dbf end");
 						return dbfReceiver->msgSize;
 					}
@@ -1060,6 +2001,7 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 				}
 				default:
 				{
+					DbfReceiverCrcUpdate(dbfReceiver, ch, dbfReceiver->msgSize);
 					if (DbfReceiverStoreByte(dbfReceiver, ch) != 0)
 					{
 						// Discard the message, it was too long.
@@ -1084,6 +2026,71 @@ int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch)
 	return 0;
 }
 
+/**
+ * Same as calling DbfReceiverProcessCh for each byte but faster.
+ * Bytes are taken until a message is complete or all len bytes are used.
+ * The number of bytes used is given in nOfBytesUsed, if a message was
+ * completed the remaining bytes shall be given again after the
+ * message has been processed (and the receiver reinitialized).
+ * Returns same as DbfReceiverProcessCh.
+ */
+int DbfReceiverProcessSpan(DbfReceiver *dbfReceiver, const unsigned char *ptr, unsigned int len, unsigned int *nOfBytesUsed)
+{
+	unsigned int i = 0;
+	int r = 0;
+
+	while ((i < len) && (r == 0))
+	{
+		switch (dbfReceiver->receiverState)
+		{
+			case DbfRcvReceivingMessageState:
+			{
+				// Take all bytes until begin or end code, as long as there is room for them.
+				unsigned int pos = dbfReceiver->msgSize;
+				const unsigned int end = (len - i < sizeof(dbfReceiver->buffer) - pos) ? pos + (len - i) : sizeof(dbfReceiver->buffer);
+				while ((pos < end) && (ptr[i] > DBF_END_CODEID))
+				{
+					const unsigned char ch = ptr[i++];
+					DbfReceiverCrcUpdate(dbfReceiver, ch, pos);
+					dbfReceiver->buffer[pos++] = ch;
+				}
+				if (pos != dbfReceiver->msgSize)
+				{
+					dbfReceiver->msgSize = pos;
+					dbfReceiver->timeoutCounter = 0;
+					continue;
+				}
+				break;
+			}
+			case DbfRcvReceivingTxtState:
+			{
+				// Take all bytes until CR, LF or begin code. Leave room for the
+				// last byte, DbfReceiverProcessCh shall handle when buffer is full.
+				unsigned int pos = dbfReceiver->msgSize;
+				const unsigned int end = (len - i < sizeof(dbfReceiver->buffer) - 1 - pos) ? pos + (len - i) : sizeof(dbfReceiver->buffer) - 1;
+				while ((pos < end) && (ptr[i] != DBF_BEGIN_CODEID) && (ptr[i] != '\r') && (ptr[i] != '\n'))
+				{
+					dbfReceiver->buffer[pos++] = ptr[i++];
+				}
+				if (pos != dbfReceiver->msgSize)
+				{
+					dbfReceiver->msgSize = pos;
+					continue;
+				}
+				break;
+			}
+			default:
+				break;
+		}
+
+		// Delimiters and other states.
+		r = DbfReceiverProcessCh(dbfReceiver, ptr[i++]);
+	}
+
+	*nOfBytesUsed = i;
+	return r;
+}
+
 int DbfReceiverIsDbf(const DbfReceiver *dbfReceiver)
 {
 	return ((dbfReceiver->receiverState == DbfRcvDbfReceivedState) || (dbfReceiver->receiverState == DbfRcvDbfReceivedMoreExpectedState));
@@ -1094,6 +2101,28 @@ int DbfReceiverIsTxt(const DbfReceiver *dbfReceiver)
 	return (dbfReceiver->receiverState == DbfRcvTxtReceivedState);
 }
 
+DBF_CRC_RESULT DbfReceiverGetCrcResult(const DbfReceiver *dbfReceiver)
+{
+	return DbfReceiverIsDbf(dbfReceiver) ? dbfReceiver->crcResult : DBF_NO_CRC;
+}
+
+DBF_VALIDATE_RESULT DbfReceiverGetValidResult(const DbfReceiver *dbfReceiver)
+{
+	return DbfReceiverIsDbf(dbfReceiver) ? dbfReceiver->validResult : DBF_NOT_VALIDATED;
+}
+
+DBF_CRC_RESULT DbfUnserializerInitFromReceiver(DbfUnserializer *dbfUnserializer, const DbfReceiver *dbfReceiver)
+{
+	const DBF_CRC_RESULT r = DbfReceiverGetCrcResult(dbfReceiver);
+	dbfUnserializer->msgPtr = dbfReceiver->buffer + dbfReceiver->bodyPos;
+	dbfUnserializer->msgSize = (r == DBF_OK_CRC) ? dbfReceiver->codePos - dbfReceiver->bodyPos : 0;
+	dbfUnserializer->decodeState = DbfIntegerCodeState;
+	dbfUnserializer->readPos = 0;
+	dbfUnserializer->repeatPos = -1;
+	dbfUnserializer->repeatCount = 0;
+	return r;
+}
+
 // TODO Use system time instead of needing delta time as parameter.
 void DbfReceiverTick(DbfReceiver *dbfReceiver, unsigned int deltaMs)
 {
@@ -1121,3 +2150,211 @@ void DbfReceiverTick(DbfReceiver *dbfReceiver, unsigned int deltaMs)
 
 
 
+void DbfReceiveQueueInit(DbfReceiveQueue *dbfReceiveQueue)
+{
+	DbfReceiverInit(&dbfReceiveQueue->receiver);
+	dbfReceiveQueue->head = 0;
+	dbfReceiveQueue->tail = 0;
+	dbfReceiveQueue->arenaHead = 0;
+	dbfReceiveQueue->nOfDropped = 0;
+	dbfReceiveQueue->isPending = 0;
+}
+
+// Find room in arena for a message of size bytes.
+// Returns offset in arena or -1 if there is no room.
+static int DbfReceiveQueueAlloc(DbfReceiveQueue *dbfReceiveQueue, unsigned int size)
+{
+	if (dbfReceiveQueue->head == dbfReceiveQueue->tail)
+	{
+		// Queue is empty so all of arena is free.
+		dbfReceiveQueue->arenaHead = 0;
+		return (size <= DBF_RCV_QUEUE_ARENA_SIZE) ? 0 : -1;
+	}
+
+	if ((dbfReceiveQueue->head - dbfReceiveQueue->tail) >= DBF_RCV_QUEUE_MAX_FRAMES)
+	{
+		return -1;
+	}
+
+	const unsigned int oldest = dbfReceiveQueue->frames[dbfReceiveQueue->tail % DBF_RCV_QUEUE_MAX_FRAMES].msgPtr - dbfReceiveQueue->arena;
+	const unsigned int h = dbfReceiveQueue->arenaHead;
+
+	// Messages are never empty so if head is after oldest the arena has not wrapped.
+	if (h > oldest)
+	{
+		if (h + size <= DBF_RCV_QUEUE_ARENA_SIZE)
+		{
+			return h;
+		}
+		// Not enough room at end of arena, try at beginning.
+		return (size <= oldest) ? 0 : -1;
+	}
+	return (h + size <= oldest) ? (int)h : -1;
+}
+
+static int DbfReceiveQueuePut(DbfReceiveQueue *dbfReceiveQueue)
+{
+	const DbfReceiver *dbfReceiver = &dbfReceiveQueue->receiver;
+	const int offset = DbfReceiveQueueAlloc(dbfReceiveQueue, dbfReceiver->msgSize);
+	if (offset < 0)
+	{
+		return -1;
+	}
+
+	unsigned char *dst = dbfReceiveQueue->arena + offset;
+	for(unsigned int i = 0; i < dbfReceiver->msgSize; i++)
+	{
+		dst[i] = dbfReceiver->buffer[i];
+	}
+
+	DbfFrame *f = &dbfReceiveQueue->frames[dbfReceiveQueue->head % DBF_RCV_QUEUE_MAX_FRAMES];
+	f->msgPtr = dst;
+	f->msgSize = dbfReceiver->msgSize;
+	f->isDbf = DbfReceiverIsDbf(dbfReceiver);
+	f->crcResult = DbfReceiverGetCrcResult(dbfReceiver);
+	f->validResult = DbfReceiverGetValidResult(dbfReceiver);
+	f->crcPos = dbfReceiver->codePos;
+	f->bodyPos = DbfReceiverIsDbf(dbfReceiver) ? dbfReceiver->bodyPos : 0;
+
+	dbfReceiveQueue->arenaHead = offset + dbfReceiver->msgSize;
+	dbfReceiveQueue->head++;
+	return 0;
+}
+
+// Put the message in receiver in queue. If there is no room it is kept in
+// receiver (isPending) until there is. Returns 0 if it was put in queue.
+static int DbfReceiveQueuePutReceived(DbfReceiveQueue *dbfReceiveQueue)
+{
+	if (DbfReceiveQueuePut(dbfReceiveQueue) != 0)
+	{
+		if (dbfReceiveQueue->head != dbfReceiveQueue->tail)
+		{
+			dbfReceiveQueue->isPending = 1;
+			return -1;
+		}
+		// Queue is empty and it still does not fit, it never will.
+		dbfDebugLog("too large for queue");
+		dbfReceiveQueue->nOfDropped++;
+		dbfReceiveQueue->isPending = 0;
+		DbfReceiverInit(&dbfReceiveQueue->receiver);
+		return -1;
+	}
+	dbfReceiveQueue->isPending = 0;
+	DbfReceiverInit(&dbfReceiveQueue->receiver);
+	return 0;
+}
+
+int DbfReceiveQueueProcessSpan(DbfReceiveQueue *dbfReceiveQueue, const unsigned char *ptr, unsigned int len, unsigned int *nOfBytesUsed)
+{
+	int n = 0;
+	int nOk = 1;
+	*nOfBytesUsed = 0;
+
+	// A message that did not fit last time goes first.
+	if (dbfReceiveQueue->isPending)
+	{
+		if (DbfReceiveQueuePutReceived(dbfReceiveQueue) == 0)
+		{
+			n++;
+		}
+		else if (dbfReceiveQueue->isPending)
+		{
+			return 0;
+		}
+	}
+
+	while (len > 0)
+	{
+		unsigned int nOfBytesUsedNow = 0;
+		const int r = DbfReceiverProcessSpan(&dbfReceiveQueue->receiver, ptr, len, &nOfBytesUsedNow);
+		ptr += nOfBytesUsedNow;
+		len -= nOfBytesUsedNow;
+		*nOfBytesUsed += nOfBytesUsedNow;
+
+		if (r > 0)
+		{
+			// A full message or line has been received.
+			if (DbfReceiveQueuePutReceived(dbfReceiveQueue) == 0)
+			{
+				n++;
+			}
+			else if (dbfReceiveQueue->isPending)
+			{
+				// Queue is full, the rest of the bytes will have to wait.
+				break;
+			}
+		}
+		else if (r < 0)
+		{
+			nOk = 0;
+			DbfReceiverInit(&dbfReceiveQueue->receiver);
+		}
+	}
+	return nOk ? n : -1;
+}
+
+const DbfFrame* DbfReceiveQueuePeek(const DbfReceiveQueue *dbfReceiveQueue)
+{
+	if (dbfReceiveQueue->head == dbfReceiveQueue->tail)
+	{
+		return NULL;
+	}
+	return &dbfReceiveQueue->frames[dbfReceiveQueue->tail % DBF_RCV_QUEUE_MAX_FRAMES];
+}
+
+void DbfReceiveQueueRemove(DbfReceiveQueue *dbfReceiveQueue)
+{
+	if (dbfReceiveQueue->head != dbfReceiveQueue->tail)
+	{
+		dbfReceiveQueue->tail++;
+	}
+}
+
+DBF_CRC_RESULT DbfUnserializerInitFromFrame(DbfUnserializer *dbfUnserializer, const DbfFrame *dbfFrame)
+{
+	const DBF_CRC_RESULT r = dbfFrame->isDbf ? dbfFrame->crcResult : DBF_NO_CRC;
+	dbfUnserializer->msgPtr = dbfFrame->msgPtr + dbfFrame->bodyPos;
+	dbfUnserializer->msgSize = (r == DBF_OK_CRC) ? dbfFrame->crcPos - dbfFrame->bodyPos : 0;
+	dbfUnserializer->decodeState = DbfIntegerCodeState;
+	dbfUnserializer->readPos = 0;
+	dbfUnserializer->repeatPos = -1;
+	dbfUnserializer->repeatCount = 0;
+	return r;
+}
+
+int DbfFrameReadTtl(const DbfFrame *dbfFrame, unsigned int *nextPos)
+{
+	const unsigned char *ptr = dbfFrame->msgPtr;
+	*nextPos = 0;
+	if ((dbfFrame->bodyPos == 0) || ((ptr[0] & ~DBF_NETOPT_DATAMASK) != DBF_NETOPT_CODEID))
+	{
+		return -1;
+	}
+
+	// Same as DbfDecodeFwd32 but for the networking option code.
+	uint32_t d = ptr[0] & DBF_NETOPT_DATAMASK;
+	unsigned int n = DBF_NETOPT_DATANBITS;
+	unsigned int idx = 1;
+	while ((idx < dbfFrame->bodyPos) && ((ptr[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+	{
+		if (n < 31)
+		{
+			d |= (uint32_t)(ptr[idx] & DBF_EXT_DATAMASK) << n;
+		}
+		n += DBF_EXT_DATANBITS;
+		idx++;
+	}
+	*nextPos = idx;
+	return (int)(d & 0x7FFFFFFF);
+}
+
+uint32_t DbfFrameHash(const DbfFrame *dbfFrame)
+{
+	if (dbfFrame->isDbf && (dbfFrame->crcResult == DBF_OK_CRC))
+	{
+		int32_t crc;
+		DbfDecodeFwd32(dbfFrame->msgPtr, dbfFrame->crcPos, dbfFrame->msgSize, &crc);
+		return (uint32_t)crc;
+	}
+	return crc32_calculate(dbfFrame->msgPtr + dbfFrame->bodyPos, dbfFrame->msgSize - dbfFrame->bodyPos);
+}
@@ -33,6 +33,11 @@
 #define DBF_SPEC_DATANBITS 3
 #define DBF_SPEC_DATAMASK ((1 << 3) - 1)
 
+// Networking option (optional), used for a TTL counter, see 0000001b in Dbf.c.
+#define DBF_NETOPT_CODEID 0x02
+#define DBF_NETOPT_DATANBITS 1
+#define DBF_NETOPT_DATAMASK ((1 << 1) - 1)
+
 #define DBF_END_CODEID 0x01
 #define DBF_BEGIN_CODEID 0x00
 
@@ -43,33 +48,107 @@ void dbfDebugLog(const char *str);
 enum
 {
 	DBF_INT_BEGIN_CODE = 0,
-	DBF_STR_BEGIN_CODE = 1
+	DBF_STR_BEGIN_CODE = 1,
+	DBF_CSTR_BEGIN_CODE = 2,
+	DBF_ARRAY_BEGIN_CODE = 4,
+	DBF_DECIMAL_BEGIN_CODE = 5
 };
 
 enum
 {
 	DBF_ENCODER_IDLE = 0,
 	DBF_ENCODING_INT = 1,
-	DBF_ENCODING_STR = 2
+	DBF_ENCODING_STR = 2,
+	DBF_ENCODING_ARRAY = 3,
+	DBF_ENCODING_DECIMAL = 4
 };
 
+// Size of the buffers used for most messages, see DbfSerializerInitBuffer.
+#define DBF_SERIALIZER_BUFFER_SIZE 120
+
 typedef struct {
-	char buffer[120];
+	// The buffer is supplied by caller, see DbfSerializerInitBuffer.
+	char *buffer;
+	unsigned int capacity;
 	unsigned int pos;
 	int encoderState;
+
+	// Set if something did not fit in buffer, the message is then not complete.
+	uint8_t overflow;
+
+	// For repetition codes, see DbfSerializerWriteRepeat.
+	int64_t lastValue;
+	unsigned int repeatCount;
+	unsigned int repeatPos;
+
+	// CRC of the bytes in buffer before crcPos, see DbfSerializerCrcUpdate.
+	uint32_t crc;
+	unsigned int crcPos;
 } DbfSerializer;
 
-// TODO Some way to know/check after if we tried to write more than there was room for in the message.
+// Give the serializer a buffer to write messages into and init it.
+void DbfSerializerInitBuffer(DbfSerializer *dbfSerializer, char *bufPtr, unsigned int bufSize);
 
+// Start a new message in the buffer given by DbfSerializerInitBuffer.
 void DbfSerializerInit(DbfSerializer *dbfSerializer);
 
+// Returns non zero if something written since init did not fit in the buffer.
+int DbfSerializerIsOverflow(const DbfSerializer *dbfSerializer);
+
 void DbfSerializerWriteInt32(DbfSerializer *dbfSerializer, int32_t i);
 void DbfSerializerWriteInt64(DbfSerializer *dbfSerializer, int64_t i);
 
 void DbfSerializerWriteString(DbfSerializer *dbfSerializer, const char *str);
 
+// Same as DbfSerializerWriteString but common words are sent as a single
+// code, see DBF_CSTR_BEGIN_CODE. DbfSerializerWriteString does this if
+// DBF_COMPACT_STRINGS is defined.
+void DbfSerializerWriteCompactString(DbfSerializer *dbfSerializer, const char *str);
+
+// In compact strings number codes below this are characters, from this and up words.
+#define DBF_STRING_DICTIONARY_FIRST 64
+
+// Word number idx in the dictionary used by compact strings, NULL if there is none.
+const char* DbfStringDictionaryGetWord(unsigned int idx);
+
+// Writes mantissa * 10^exponent.
+void DbfSerializerWriteDecimal(DbfSerializer *dbfSerializer, int64_t mantissa, int32_t exponent);
+
+// Gives the mantissa and exponent as the receiver will get them, 2310e-1 becomes 231e0.
+void DbfDecimalNormalize(int64_t *mantissa, int32_t *exponent);
+
+// Packed arrays, these use much less space than writing one int at a time.
+void DbfSerializerWriteArray8(DbfSerializer *dbfSerializer, const uint8_t *ptr, unsigned int nOfElements);
+void DbfSerializerWriteArray16(DbfSerializer *dbfSerializer, const int16_t *ptr, unsigned int nOfElements);
+void DbfSerializerWriteArray32(DbfSerializer *dbfSerializer, const int32_t *ptr, unsigned int nOfElements);
+
 void DbfSerializerResetMesssage(DbfSerializer *dbfSerializer);
 
+// Write a TTL (hop count) networking option. This must be written first in
+// the message (before any other codes) and is not included in the CRC.
+void DbfSerializerWriteTtl(DbfSerializer *dbfSerializer, unsigned int ttl);
+
+// A saved start of a message. Messages that always begin with the same codes
+// can start with a copy of these instead of encoding them every time.
+#define DBF_TEMPLATE_SIZE 24
+typedef struct {
+	char buffer[DBF_TEMPLATE_SIZE];
+	uint8_t len; // Zero if not saved.
+	uint8_t encoderState;
+	int64_t lastValue;
+	unsigned int repeatCount;
+	unsigned int repeatPos;
+	uint32_t crc;
+	unsigned int crcPos;
+} DbfTemplate;
+
+// Saves what has been written to dbfSerializer so far.
+// Returns 0 if OK, -1 if it did not fit in the template or in dbfSerializer.
+int DbfTemplateSave(DbfTemplate *dbfTemplate, const DbfSerializer *dbfSerializer);
+
+// Init dbfSerializer to the state it had when dbfTemplate was saved.
+void DbfSerializerInitFromTemplate(DbfSerializer *dbfSerializer, const DbfTemplate *dbfTemplate);
+
 void DbfSerializerWriteCrc(DbfSerializer *dbfSerializer);
 
 const char* DbfSerializerGetMsgPtr(const DbfSerializer *dbfSerializer);
@@ -84,6 +163,9 @@ typedef enum
 	DbfInitialCodeState,
 	DbfIntegerCodeState,
 	DbfStringCodeState,
+	DbfCompactStringCodeState,
+	DbfArrayCodeState,
+	DbfDecimalCodeState,
 	DbfEndCodeState,
 	DbfErrorState,
 } DbfCodeStateEnum;
@@ -95,7 +177,7 @@ typedef enum
 	DbfINT, // POSITIVE_NUMBER_CODE_TYPE
 	DbfNEG, // NEGATIVE_NUMBER_CODE_TYPE
 	DbfCRC, // FMTCRC_CODE_TYPE, format or CRC 
-	DbfSCT, // SPECIAL_CODE_TYPE currently used for format, but will be used for repeat.
+	DbfSCT, // SPECIAL_CODE_TYPE version code at start of message, repetition code after a number.
 	DbfEMC, // ENDOFMSG_CODE_TYPE
 	DbfECT  // ERROR_CODE_TYPE
 } DbfCodeTypesEnum;
@@ -118,8 +200,21 @@ typedef struct
 	DbfCodeStateEnum decodeState;
 
 	unsigned int readPos;
+
+	// Position of the number code that a repetition code repeats, -1 if none.
+	int repeatPos;
+	// How many more times that number shall be given.
+	unsigned int repeatCount;
 } DbfUnserializer;
 
+// Refers to a packed array inside a received message, see DbfUnserializerReadArray.
+typedef struct
+{
+	const unsigned char *ptr;
+	uint16_t nOfElements;
+	uint8_t elementSize; // In bytes
+} DbfArray;
+
 // TODO Some way to know/check after if we tried to read more than there was in the message.
 
 DBF_CRC_RESULT DbfUnserializerInit(DbfUnserializer *dbfUnserializer, const unsigned char *msgPtr, unsigned int msgSize);
@@ -130,10 +225,19 @@ int32_t DbfUnserializerReadInt32(DbfUnserializer *dbfUnserializer);
 int64_t DbfUnserializerReadInt64(DbfUnserializer *dbfUnserializer);
 
 
+// Reads a string, both normal and compact strings (see DbfSerializerWriteCompactString).
 int DbfUnserializerReadString(DbfUnserializer *dbfUnserializer, char* bufPtr, int bufLen);
 
+int DbfUnserializerReadArray(DbfUnserializer *dbfUnserializer, DbfArray *dbfArray);
+
+int DbfUnserializerReadDecimal(DbfUnserializer *dbfUnserializer, int64_t *mantissa, int32_t *exponent);
+
 int DbfUnserializerReadIsNextString(DbfUnserializer *dbfUnserializer);
 
+int DbfUnserializerReadIsNextArray(DbfUnserializer *dbfUnserializer);
+
+int DbfUnserializerReadIsNextDecimal(DbfUnserializer *dbfUnserializer);
+
 int DbfUnserializerReadIsNextInt(DbfUnserializer *dbfUnserializer);
 
 int DbfUnserializerReadIsNextEnd(DbfUnserializer *dbfUnserializer);
@@ -147,6 +251,45 @@ int DbfUnserializerGetIntRev(const DbfUnserializer *dbfUnserializer, unsigned in
 char DbfUnserializerIsOk(DbfUnserializer *dbfUnserializer);
 
 
+// Max number of codes that a DbfFieldIndex can hold.
+#define DBF_FIELD_INDEX_SIZE 64
+
+// Where in the message a code is and what type it is.
+typedef struct
+{
+	uint8_t type; // DbfCodeTypesEnum
+	uint8_t length; // Number of bytes, the start sub code and its extension sub codes.
+	uint16_t offset; // Index in message of the start sub code.
+	uint16_t first; // Number of the code, counting repeated numbers every time.
+	uint16_t repeatCount; // Times the number is given after the first, see repetition code.
+} DbfFieldIndexEntry;
+
+// An index over all codes in a message, so that a code can be
+// fetched by its number without decoding those before it.
+// Note that format codes (like the one before a string) are also codes.
+// A number followed by a repetition code is one entry that gives the
+// number every time, so codes are numbered as DbfUnserializer reads them.
+typedef struct
+{
+	const unsigned char *msgPtr;
+	unsigned int nOfCodes;
+	unsigned int nOfEntries;
+	DbfFieldIndexEntry codes[DBF_FIELD_INDEX_SIZE];
+} DbfFieldIndex;
+
+int DbfFieldIndexInit(DbfFieldIndex *dbfFieldIndex, const unsigned char *msgPtr, unsigned int msgSize);
+unsigned int DbfFieldIndexGetNOfCodes(const DbfFieldIndex *dbfFieldIndex);
+DbfCodeTypesEnum DbfFieldIndexGetType(const DbfFieldIndex *dbfFieldIndex, unsigned int i);
+int32_t DbfFieldIndexGetInt32(const DbfFieldIndex *dbfFieldIndex, unsigned int i);
+int64_t DbfFieldIndexGetInt64(const DbfFieldIndex *dbfFieldIndex, unsigned int i);
+
+
+unsigned int DbfArrayGetNOfElements(const DbfArray *dbfArray);
+uint8_t DbfArrayGetUint8(const DbfArray *dbfArray, unsigned int i);
+int16_t DbfArrayGetInt16(const DbfArray *dbfArray, unsigned int i);
+int32_t DbfArrayGetInt32(const DbfArray *dbfArray, unsigned int i);
+
+
 #define DBF_RCV_TIMEOUT_MS 5000
 
 // Buffer size, not in bytes but in number of 32bit words,
@@ -156,6 +299,15 @@ char DbfUnserializerIsOk(DbfUnserializer *dbfUnserializer);
 #define DBF_BUFFER_SIZE_32BIT 32
 #define BYTES_PER_32BIT_WORD 4
 
+// Largest message (CRC included but not networking options) that
+// DbfReceiverValidate accepts. Leaves room for a TTL (up to 255 it takes
+// 2 bytes) so that it can be forwarded.
+#define DBF_MAX_BODY_SIZE (DBF_BUFFER_SIZE_32BIT*BYTES_PER_32BIT_WORD - 2)
+
+// Max number of extension sub codes in a 64 bit number code. Only the data
+// of packed arrays (start sub code 01000000) may have more than this.
+#define DBF_MAX_EXT_CODES 9
+
 typedef enum
 {
 	DbfRcvInitialState,
@@ -169,6 +321,16 @@ typedef enum
 } DbfReveiverCodeStateEnum;
 
 
+// Result of the check done by DbfReceiverValidate.
+typedef enum
+{
+	DBF_VALID=0,
+	DBF_NOT_VALIDATED=1, // Text, not a DBF message.
+	DBF_INVALID_CRC=-1, // Bad or no CRC.
+	DBF_INVALID_CODE=-2, // A code that is not allowed where it is.
+	DBF_INVALID_SIZE=-3
+} DBF_VALIDATE_RESULT;
+
 typedef struct
 {
 	unsigned char buffer[DBF_BUFFER_SIZE_32BIT*BYTES_PER_32BIT_WORD];
@@ -176,6 +338,21 @@ typedef struct
 	DbfReveiverCodeStateEnum receiverState;
 	int timeoutCounter;
 
+	// The CRC is calculated as bytes are received. When a message is
+	// complete crcBeforeCode is the CRC of all except its last code
+	// (that is the received CRC) which begins at codePos.
+	uint32_t crc;
+	uint32_t crcBeforeCode;
+	unsigned int codePos;
+	DBF_CRC_RESULT crcResult;
+
+	// Where the message body begins, after any networking options
+	// (these are not included in the CRC).
+	unsigned int bodyPos;
+
+	// Set when a DBF message is complete, see DbfReceiverGetValidResult.
+	DBF_VALIDATE_RESULT validResult;
+
 	//uint64_t clear_time_stamp;
 	uint64_t first_time_stamp;
 	//uint64_t latest_time_stamp;
@@ -189,14 +366,88 @@ void DbfReceiverInit(DbfReceiver *dbfReceiver);
 // Call this at every character received. Returns >0 when there is a message to process.
 int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch);
 
+// Same as DbfReceiverProcessCh but for all bytes available (or until a message is ready).
+int DbfReceiverProcessSpan(DbfReceiver *dbfReceiver, const unsigned char *ptr, unsigned int len, unsigned int *nOfBytesUsed);
+
 int DbfReceiverIsDbf(const DbfReceiver *dbfReceiver);
 int DbfReceiverIsTxt(const DbfReceiver *dbfReceiver);
 
 // This is intended to be called at a regular interval. It is used to check for timeouts in the receiving of messages.
 void DbfReceiverTick(DbfReceiver *dbfReceiver, unsigned int deltaMs);
 
+// Result of the CRC check, available when a DBF message has been received.
+DBF_CRC_RESULT DbfReceiverGetCrcResult(const DbfReceiver *dbfReceiver);
+
+// Result of checking the received message without decoding it. That is CRC,
+// size and that codes are only where they are allowed. Checked once when the
+// message is complete, so this is cheap to call. Gives DBF_NOT_VALIDATED for text.
+DBF_VALIDATE_RESULT DbfReceiverGetValidResult(const DbfReceiver *dbfReceiver);
+
+// Same as DbfUnserializerInit but using the CRC check already done by dbfReceiver.
+DBF_CRC_RESULT DbfUnserializerInitFromReceiver(DbfUnserializer *dbfUnserializer, const DbfReceiver *dbfReceiver);
+
 // Note, this is not same as DbfUnserializerReadString. This gives the entire message in ascii.
 int DbfReceiverToString(DbfReceiver *dbfReceiver, const char* bufPtr, int bufLen);
 
 
+// Size of the arena in which received messages are kept until processed.
+#define DBF_RCV_QUEUE_ARENA_SIZE 512
+// Max number of messages in queue, shall be a power of 2.
+#define DBF_RCV_QUEUE_MAX_FRAMES 8
+
+// Descriptor of a received message (or text line) in a DbfReceiveQueue.
+typedef struct
+{
+	const unsigned char *msgPtr;
+	uint16_t msgSize;
+	uint16_t crcPos; // Where the CRC code begins, if crcResult is DBF_OK_CRC.
+	uint16_t bodyPos; // Where the message begins after any networking options.
+	uint8_t isDbf; // Zero if this is a text line.
+	int8_t crcResult; // DBF_CRC_RESULT
+	int8_t validResult; // DBF_VALIDATE_RESULT
+} DbfFrame;
+
+// A DbfReceiver and a queue of messages it has received.
+// Messages are copied into the arena (in a ring buffer fashion) as
+// they are completed so that the receiver can continue with next
+// message directly. The messages can then be processed in batches.
+typedef struct
+{
+	DbfReceiver receiver;
+	unsigned char arena[DBF_RCV_QUEUE_ARENA_SIZE];
+	DbfFrame frames[DBF_RCV_QUEUE_MAX_FRAMES];
+	unsigned int head; // Where next frame is put, counts up and wraps.
+	unsigned int tail; // Oldest frame, counts up and wraps.
+	unsigned int arenaHead; // Where in arena next message shall be put.
+	unsigned int nOfDropped; // Messages lost since they are larger than the arena.
+	unsigned int isPending; // A message in receiver is waiting for room in queue.
+} DbfReceiveQueue;
+
+void DbfReceiveQueueInit(DbfReceiveQueue *dbfReceiveQueue);
+
+// Give all received bytes to this. Complete messages are put in the queue.
+// If the queue gets full it stops, nOfBytesUsed tells how many bytes were
+// taken. Empty the queue and give the rest of the bytes again.
+// Returns number of messages put in queue or -1 if something was wrong.
+int DbfReceiveQueueProcessSpan(DbfReceiveQueue *dbfReceiveQueue, const unsigned char *ptr, unsigned int len, unsigned int *nOfBytesUsed);
+
+// Oldest message in queue or NULL if queue is empty.
+const DbfFrame* DbfReceiveQueuePeek(const DbfReceiveQueue *dbfReceiveQueue);
+
+// Remove the oldest message, call when done with the message given by DbfReceiveQueuePeek.
+void DbfReceiveQueueRemove(DbfReceiveQueue *dbfReceiveQueue);
+
+// Same as DbfUnserializerInitFromReceiver but for a message in a DbfReceiveQueue.
+DBF_CRC_RESULT DbfUnserializerInitFromFrame(DbfUnserializer *dbfUnserializer, const DbfFrame *dbfFrame);
+
+// TTL of a received message or -1 if it has none. A TTL is expected to be the
+// first networking option. nextPos is set to where the rest of the message
+// (that is all after the TTL) begins.
+int DbfFrameReadTtl(const DbfFrame *dbfFrame, unsigned int *nextPos);
+
+// Hash of the message body, networking options are not included so it is the
+// same on every hop. It is the CRC of the message if it has a correct one.
+uint32_t DbfFrameHash(const DbfFrame *dbfFrame);
+
+
 #endif /* DBF_H_ */
@@ -0,0 +1,419 @@
+/*
+DbfScan.c
+
+Fast decoding of DBF messages, see DbfScan.h.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+#include "Dbf.h"
+#include "DbfScan.h"
+
+#if (defined __BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "DbfScan needs a little endian CPU"
+#endif
+
+// The extension bit of each byte in a 64 bit word.
+#define DBF_SCAN_EXT_BITS 0x8080808080808080ULL
+#define DBF_SCAN_LOW_BITS 0x7F7F7F7F7F7F7F7FULL
+
+// Type of a start sub code given the position of its highest bit that is set,
+// that bit tells the type, the bits below it are data. See sub codes in Dbf.c.
+static const uint8_t dbfScanTypeTable[8] = {DbfNCT, DbfNCT, DbfNCT, DbfSCT, DbfCRC, DbfNEG, DbfINT, DbfEXT};
+
+// Load 8 bytes, bytes after end are given as zero. A zero is a begin
+// code so the end of message works as the beginning of a code.
+static inline uint64_t DbfScanLoad64(const unsigned char *ptr, const unsigned char *end)
+{
+	uint64_t w = 0;
+	if (end - ptr >= 8)
+	{
+		memcpy(&w, ptr, 8);
+	}
+	else if (ptr < end)
+	{
+		memcpy(&w, ptr, end - ptr);
+	}
+	return w;
+}
+
+// Gives 0x80 in each byte of x that is zero, 0 in the others.
+static inline uint64_t DbfScanZeroBytes(uint64_t x)
+{
+	return ~(((x & DBF_SCAN_LOW_BITS) + DBF_SCAN_LOW_BITS) | x | DBF_SCAN_LOW_BITS);
+}
+
+// Number of the first byte that has 0x80 set in m, m shall not be zero.
+static inline unsigned int DbfScanFirstByte(uint64_t m)
+{
+	return __builtin_ctzll(m) >> 3;
+}
+
+// The data of up to 8 extension sub codes (loaded into w) put together,
+// 7 bits from each. Done without a loop, pairs of bytes are joined, then
+// pairs of those and so on.
+static inline uint64_t DbfScanExtData(uint64_t w, unsigned int nOfExt)
+{
+	w &= (nOfExt < 8) ? ((1ULL << (8 * nOfExt)) - 1) : ~0ULL;
+	w &= DBF_SCAN_LOW_BITS;
+	w = ((w & 0x7F007F007F007F00ULL) >> 1) | (w & 0x007F007F007F007FULL);
+	w = ((w & 0x3FFF00003FFF0000ULL) >> 2) | (w & 0x00003FFF00003FFFULL);
+	w = ((w & 0x0FFFFFFF00000000ULL) >> 4) | (w & 0x000000000FFFFFFFULL);
+	return w;
+}
+
+// Value of a number code, see DbfScanDecodeCode.
+static inline int64_t DbfScanNumber(uint8_t type, uint64_t data)
+{
+	return (type == DbfNEG) ? (int64_t)(-1 - (int64_t)data) : (int64_t)data;
+}
+
+const unsigned char* DbfScanFindDelimiter(const unsigned char *ptr, const unsigned char *end)
+{
+	while (ptr < end)
+	{
+		// Begin and end codes are the bytes 0 and 1.
+		const uint64_t w = DbfScanLoad64(ptr, end);
+		const uint64_t m = DbfScanZeroBytes(w & 0xFEFEFEFEFEFEFEFEULL);
+		if (m != 0)
+		{
+			const unsigned char *p = ptr + DbfScanFirstByte(m);
+			return (p < end) ? p : end;
+		}
+		ptr += 8;
+	}
+	return end;
+}
+
+unsigned int DbfScanCodeLength(const unsigned char *ptr, const unsigned char *end)
+{
+	const unsigned char *p = ptr + 1;
+	for(;;)
+	{
+		const uint64_t starts = ~DbfScanLoad64(p, end) & DBF_SCAN_EXT_BITS;
+		if (starts != 0)
+		{
+			return p + DbfScanFirstByte(starts) - ptr;
+		}
+		p += 8;
+	}
+}
+
+unsigned int DbfScanDecodeCode(const unsigned char *ptr, const unsigned char *end, uint8_t *type, uint64_t *data)
+{
+	const unsigned int b = ptr[0];
+	const unsigned int nOfBits = 31 - __builtin_clz(b | 1);
+	*type = dbfScanTypeTable[nOfBits];
+	uint64_t d = b & ((1U << nOfBits) - 1);
+
+	const uint64_t w = DbfScanLoad64(ptr + 1, end);
+	const uint64_t starts = ~w & DBF_SCAN_EXT_BITS;
+	const unsigned int nOfExt = (starts != 0) ? DbfScanFirstByte(starts) : 8;
+	d |= DbfScanExtData(w, nOfExt) << nOfBits;
+	unsigned int len = 1 + nOfExt;
+
+	if (nOfExt == 8)
+	{
+		// More than 56 bits, rare so one byte at a time.
+		unsigned int n = nOfBits + 8 * DBF_EXT_DATANBITS;
+		while ((ptr + len < end) && ((ptr[len] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+		{
+			if (n < 64)
+			{
+				d |= (uint64_t)(ptr[len] & DBF_EXT_DATAMASK) << n;
+			}
+			n += DBF_EXT_DATANBITS;
+			len++;
+		}
+	}
+
+	*data = d;
+	return len;
+}
+
+// Find the last code, the CRC. Searching backwards 8 bytes at a time.
+static const unsigned char* DbfScanFindLastCode(const unsigned char *begin, const unsigned char *end)
+{
+	const unsigned char *p = end;
+	while (p - begin >= 8)
+	{
+		uint64_t w;
+		memcpy(&w, p - 8, 8);
+		const uint64_t starts = ~w & DBF_SCAN_EXT_BITS;
+		if (starts != 0)
+		{
+			return p - 8 + ((63 - __builtin_clzll(starts)) >> 3);
+		}
+		p -= 8;
+	}
+	while (p > begin)
+	{
+		p--;
+		if ((*p & DBF_EXT_CODEMASK) != DBF_EXT_CODEID)
+		{
+			return p;
+		}
+	}
+	return NULL;
+}
+
+DBF_CRC_RESULT DbfScannerInit(DbfScanner *dbfScanner, const unsigned char *msgPtr, unsigned int msgSize)
+{
+	const unsigned char *end = msgPtr + msgSize;
+	const unsigned char *pos = msgPtr;
+
+	// Networking options are not part of the message body.
+	while ((pos < end) && (*pos > DBF_END_CODEID) && (*pos < DBF_SPEC_CODEID))
+	{
+		pos += DbfScanCodeLength(pos, end);
+	}
+
+	dbfScanner->pos = pos;
+	dbfScanner->end = pos;
+	dbfScanner->decodeState = DbfIntegerCodeState;
+
+	const unsigned char *crcPtr = DbfScanFindLastCode(pos, end);
+	if ((crcPtr == NULL) || ((*crcPtr & ~DBF_FMTCRC_DATAMASK) != DBF_FMTCRC_CODEID))
+	{
+		return DBF_NO_CRC;
+	}
+
+	uint8_t type;
+	uint64_t receivedCrc;
+	DbfScanDecodeCode(crcPtr, end, &type, &receivedCrc);
+	if ((uint32_t)receivedCrc != crc32_calculate(pos, crcPtr - pos))
+	{
+		return DBF_BAD_CRC;
+	}
+
+	dbfScanner->end = crcPtr;
+	return DBF_OK_CRC;
+}
+
+// Find end of a string, that is first code that is not a character or
+// repetition code. Done 8 bytes at a time.
+static const unsigned char* DbfScanStringEnd(const unsigned char *ptr, const unsigned char *end)
+{
+	while (ptr < end)
+	{
+		const uint64_t w = DbfScanLoad64(ptr, end);
+		// Bytes below 0x20 (not numbers or extension codes) but not 0x08-0x0F (repetition codes).
+		const uint64_t m = DbfScanZeroBytes(w & 0xE0E0E0E0E0E0E0E0ULL) & ~DbfScanZeroBytes((w & 0xF8F8F8F8F8F8F8F8ULL) ^ 0x0808080808080808ULL);
+		if (m != 0)
+		{
+			const unsigned char *p = ptr + DbfScanFirstByte(m);
+			return (p < end) ? p : end;
+		}
+		ptr += 8;
+	}
+	return end;
+}
+
+static DbfCodeStateEnum DbfScanEvaluateFormatCode(uint64_t c)
+{
+	switch(c)
+	{
+		case DBF_INT_BEGIN_CODE: return DbfIntegerCodeState;
+		case DBF_STR_BEGIN_CODE: return DbfStringCodeState;
+		case DBF_CSTR_BEGIN_CODE: return DbfCompactStringCodeState;
+		case DBF_ARRAY_BEGIN_CODE: return DbfArrayCodeState;
+		case DBF_DECIMAL_BEGIN_CODE: return DbfDecimalCodeState;
+		default: return DbfInitialCodeState;
+	}
+}
+
+// Read a number code, returns NULL if there was not one.
+static const unsigned char* DbfScanReadNumber(const unsigned char *pos, const unsigned char *end, int64_t *value)
+{
+	uint8_t type;
+	uint64_t data;
+	if (pos >= end)
+	{
+		return NULL;
+	}
+	pos += DbfScanDecodeCode(pos, end, &type, &data);
+	if ((type != DbfINT) && (type != DbfNEG))
+	{
+		return NULL;
+	}
+	*value = DbfScanNumber(type, data);
+	return pos;
+}
+
+DbfScanKindEnum DbfScanNext(DbfScanner *dbfScanner, DbfScanField *dbfScanField)
+{
+	const unsigned char *pos = dbfScanner->pos;
+	const unsigned char *end = dbfScanner->end;
+	uint8_t type;
+	uint64_t data;
+
+	// Skip format codes (and any version code) before the field.
+	for(;;)
+	{
+		if (pos >= end)
+		{
+			dbfScanner->pos = end;
+			dbfScanField->kind = DbfScanEndKind;
+			return DbfScanEndKind;
+		}
+		const unsigned int len = DbfScanDecodeCode(pos, end, &type, &data);
+		if ((type == DbfINT) || (type == DbfNEG))
+		{
+			break;
+		}
+		else if (type == DbfCRC)
+		{
+			dbfScanner->decodeState = DbfScanEvaluateFormatCode(data);
+			if ((dbfScanner->decodeState == DbfStringCodeState) || (dbfScanner->decodeState == DbfCompactStringCodeState))
+			{
+				// Each string has its own format code, so a string may also be empty.
+				pos += len;
+				break;
+			}
+		}
+		else if (type == DbfEXT)
+		{
+			dbfScanner->pos = end;
+			dbfScanField->kind = DbfScanErrorKind;
+			return DbfScanErrorKind;
+		}
+		// Version codes and optional networking codes are ignored.
+		pos += len;
+	}
+
+	dbfScanField->ptr = pos;
+	dbfScanField->count = 1;
+	dbfScanField->isCompact = 0;
+
+	switch(dbfScanner->decodeState)
+	{
+		case DbfStringCodeState:
+		case DbfCompactStringCodeState:
+			dbfScanField->kind = DbfScanStringKind;
+			dbfScanField->isCompact = (dbfScanner->decodeState == DbfCompactStringCodeState);
+			pos = DbfScanStringEnd(pos, end);
+			break;
+		case DbfDecimalCodeState:
+			dbfScanField->kind = DbfScanDecimalKind;
+			pos = DbfScanReadNumber(pos, end, &dbfScanField->value);
+			if (pos != NULL)
+			{
+				int64_t exponent = 0;
+				pos = DbfScanReadNumber(pos, end, &exponent);
+				dbfScanField->exponent = exponent;
+			}
+			break;
+		case DbfArrayCodeState:
+		{
+			int64_t elementSize = 0;
+			int64_t nOfElements = 0;
+			dbfScanField->kind = DbfScanArrayKind;
+			pos = DbfScanReadNumber(pos, end, &elementSize);
+			if (pos != NULL)
+			{
+				pos = DbfScanReadNumber(pos, end, &nOfElements);
+			}
+			if ((pos == NULL) || (pos >= end))
+			{
+				pos = NULL;
+				break;
+			}
+			// The data is in the extension sub codes of next code.
+			const unsigned int len = DbfScanCodeLength(pos, end);
+			if (((elementSize != 1) && (elementSize != 2) && (elementSize != 4)) ||
+				(nOfElements < 0) || (nOfElements > 0xFFFF) ||
+				((uint64_t)nOfElements * elementSize * 8 > (uint64_t)(len - 1) * DBF_EXT_DATANBITS))
+			{
+				pos = NULL;
+				break;
+			}
+			dbfScanField->array.ptr = pos + 1;
+			dbfScanField->array.elementSize = elementSize;
+			dbfScanField->array.nOfElements = nOfElements;
+			pos += len;
+			break;
+		}
+		default:
+		{
+			// Integers, and numbers in unknown formats.
+			dbfScanField->kind = (dbfScanner->decodeState == DbfIntegerCodeState) ? DbfScanIntKind : DbfScanOtherKind;
+			dbfScanField->value = DbfScanNumber(type, data);
+			pos += DbfScanCodeLength(pos, end);
+			if ((pos < end) && ((*pos & ~DBF_SPEC_DATAMASK) == DBF_SPEC_CODEID))
+			{
+				// A repetition code, the number is given n+1 more times.
+				pos += DbfScanDecodeCode(pos, end, &type, &data);
+				dbfScanField->count += data + 1;
+			}
+			break;
+		}
+	}
+
+	if (pos == NULL)
+	{
+		dbfScanner->pos = end;
+		dbfScanField->kind = DbfScanErrorKind;
+		return DbfScanErrorKind;
+	}
+
+	dbfScanField->size = pos - dbfScanField->ptr;
+	dbfScanner->pos = pos;
+	return dbfScanField->kind;
+}
+
+// Put the character or word that number code value stands for in buffer.
+static int DbfScanPutStringCode(int isCompact, int64_t value, char *bufPtr, int bufLen)
+{
+	if ((!isCompact) || (value < DBF_STRING_DICTIONARY_FIRST))
+	{
+		*bufPtr = value + 64;
+		return 1;
+	}
+	const char *word = DbfStringDictionaryGetWord(value - DBF_STRING_DICTIONARY_FIRST);
+	if (word == NULL)
+	{
+		word = "?";
+	}
+	int n = 0;
+	while ((word[n] != 0) && (n < bufLen))
+	{
+		bufPtr[n] = word[n];
+		n++;
+	}
+	return n;
+}
+
+int DbfScanFieldGetString(const DbfScanField *dbfScanField, char *bufPtr, int bufLen)
+{
+	if ((bufPtr == NULL) || (bufLen <= 0))
+	{
+		return 0;
+	}
+	const unsigned char *pos = dbfScanField->ptr;
+	const unsigned char *end = pos + dbfScanField->size;
+	int64_t prev = 0;
+	int n = 0;
+	while ((pos < end) && (n < bufLen - 1))
+	{
+		uint8_t type;
+		uint64_t data;
+		pos += DbfScanDecodeCode(pos, end, &type, &data);
+		if (type == DbfSCT)
+		{
+			// Repetition of previous code.
+			for(uint64_t i = 0; (i <= data) && (n < bufLen - 1); i++)
+			{
+				n += DbfScanPutStringCode(dbfScanField->isCompact, prev, bufPtr + n, bufLen - 1 - n);
+			}
+		}
+		else
+		{
+			prev = DbfScanNumber(type, data);
+			n += DbfScanPutStringCode(dbfScanField->isCompact, prev, bufPtr + n, bufLen - 1 - n);
+		}
+	}
+	bufPtr[n] = 0;
+	return n;
+}
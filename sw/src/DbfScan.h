@@ -0,0 +1,76 @@
+/*
+DbfScan.h
+
+Fast decoding of DBF messages, intended for PC programs that receive
+messages from many devices. The format is same as in Dbf.c but here
+codes are found 8 bytes at a time (SWAR, SIMD within a register, testing
+the extension bits of 8 bytes in one 64 bit word). Fields refer to the
+bytes in the message, nothing is copied unless asked for (see
+DbfScanFieldGetString). A 64 bit little endian CPU is assumed.
+
+Not used by the firmware. See dbfBench.c for how to use it.
+
+*/
+
+#ifndef DBFSCAN_H
+#define DBFSCAN_H
+
+#include <stdint.h>
+#include "Dbf.h"
+
+typedef enum
+{
+	DbfScanEndKind, // No more fields in the message.
+	DbfScanIntKind,
+	DbfScanStringKind,
+	DbfScanDecimalKind,
+	DbfScanArrayKind,
+	DbfScanOtherKind, // A number in a format not known here.
+	DbfScanErrorKind, // Message is not correctly encoded.
+} DbfScanKindEnum;
+
+// A field in a message. The data is not copied, ptr refers to the message.
+typedef struct
+{
+	DbfScanKindEnum kind;
+	const unsigned char *ptr; // Where the field begins in the message (after its format code).
+	unsigned int size; // Number of bytes in the message.
+	int64_t value; // Integer value or mantissa of decimal.
+	int32_t exponent; // Exponent of decimal.
+	unsigned int count; // Number of times an integer is repeated (1 if not repeated).
+	uint8_t isCompact; // Compact string, see DBF_CSTR_BEGIN_CODE.
+	DbfArray array; // For arrays, use the DbfArrayGet functions.
+} DbfScanField;
+
+typedef struct
+{
+	const unsigned char *pos; // Next code to read.
+	const unsigned char *end; // End of message, where the CRC begins.
+	DbfCodeStateEnum decodeState;
+} DbfScanner;
+
+// Find next begin or end code (delimiters between messages) in a stream
+// of bytes. Returns end if there was none.
+const unsigned char* DbfScanFindDelimiter(const unsigned char *ptr, const unsigned char *end);
+
+// Number of bytes in the code (start sub code and its extension sub codes)
+// that begins at ptr.
+unsigned int DbfScanCodeLength(const unsigned char *ptr, const unsigned char *end);
+
+// Decode one code, gives its type (DbfCodeTypesEnum) and data. For negative
+// numbers data is not the number, see DbfScanField. Returns length of code.
+unsigned int DbfScanDecodeCode(const unsigned char *ptr, const unsigned char *end, uint8_t *type, uint64_t *data);
+
+// Message shall be given without begin and end codes. Networking options are
+// skipped and the CRC is checked. If CRC is not OK there will be no fields.
+DBF_CRC_RESULT DbfScannerInit(DbfScanner *dbfScanner, const unsigned char *msgPtr, unsigned int msgSize);
+
+// Gives next field of the message. Returns the kind of field, DbfScanEndKind
+// when there are no more.
+DbfScanKindEnum DbfScanNext(DbfScanner *dbfScanner, DbfScanField *dbfScanField);
+
+// Copy a string field into buffer, it is zero terminated.
+// Returns number of characters (not counting the terminating zero).
+int DbfScanFieldGetString(const DbfScanField *dbfScanField, char *bufPtr, int bufLen);
+
+#endif
@@ -119,6 +119,12 @@ void BufferedSerialSoft_init(volatile BufferedSerialSoft *bufferedSerialSoft);
 void BufferedSerialSoft_init(volatile BufferedSerialSoft *bufferedSerialSoft)
 {
 	memset((void*)bufferedSerialSoft, 0, sizeof(*bufferedSerialSoft));
+	#ifdef SOFTUART1_RX_PIN
+	fifoInit(&bufferedSerialSoft->inBuffer, (char*)bufferedSerialSoft->inBufferData, sizeof(bufferedSerialSoft->inBufferData));
+	#endif
+	#ifdef SOFTUART1_TX_PIN
+	fifoInit(&bufferedSerialSoft->outBuffer, (char*)bufferedSerialSoft->outBufferData, sizeof(bufferedSerialSoft->outBufferData));
+	#endif
 };
 
 
@@ -131,6 +137,8 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 	const int unfilteredInBit = pinRead(SOFTUART1_PORT, SOFTUART1_RX_PIN);
 	bufferedSerialSoft1.inputFilter = (bufferedSerialSoft1.inputFilter << 1) + unfilteredInBit;
 	const char inBit = noiseFilter[bufferedSerialSoft1.inputFilter & 0x7];
+	// Not all of the last 3 samples are same, noise.
+	const char noisy = ((bufferedSerialSoft1.inputFilter & 0x7) != 0) && ((bufferedSerialSoft1.inputFilter & 0x7) != 0x7);
 
 	switch(bufferedSerialSoft1.inState)
 	{
@@ -146,6 +154,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 				// Start bit hopefully (or noise).
 				bufferedSerialSoft1.inCounter = 0;
 				bufferedSerialSoft1.inCh = 0;
+				bufferedSerialSoft1.inNoise = 0;
 				bufferedSerialSoft1.inState = 2;
 				//startBitCounter++;
 			}
@@ -171,6 +180,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(3L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh = inBit; // Receive LSB first
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -178,6 +188,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(5L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 1);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -185,6 +196,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(7L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 2);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -192,6 +204,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(9L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 3);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -199,6 +212,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(11L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 4);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -206,6 +220,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(13L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 5);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -213,6 +228,7 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(15L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 6);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
@@ -220,22 +236,27 @@ void __attribute__ ((interrupt, used)) TIM2_IRQHandler(void)
 			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(17L*timerFrequency,tickDivider)) )
 			{
 				bufferedSerialSoft1.inCh |= (inBit << 7);
+				bufferedSerialSoft1.inNoise |= noisy;
 				bufferedSerialSoft1.inState++;
 			}
 			break;
 		case 11:
-			// Stop bit could be checked here if break feature is needed.
-			//if (++bufferedSerialSoft1.inCounter >= (MY_DIV(19L*timerFrequency,tickDivider)) )
-			//{
-			//	if (inBit!=0)
-			//	{
-			//		// this is the break bit;
-			//	}
-			//}
-			fifoPut(&bufferedSerialSoft1.inBuffer, bufferedSerialSoft1.inCh);
-			bufferedSerialSoft1.inState=1;
-			tim2counter++;
-
+			// Middle of stop bit, it shall be 1. If not it is a framing
+			// error (or a break). The byte is kept anyway, as a usart does.
+			if (++bufferedSerialSoft1.inCounter >= (MY_DIV(19L*timerFrequency,tickDivider)) )
+			{
+				if (inBit == 0)
+				{
+					bufferedSerialSoft1.nOfFramingErrors++;
+				}
+				if (bufferedSerialSoft1.inNoise || noisy)
+				{
+					bufferedSerialSoft1.nOfNoiseErrors++;
+				}
+				fifoPut(&bufferedSerialSoft1.inBuffer, bufferedSerialSoft1.inCh);
+				bufferedSerialSoft1.inState=1;
+				tim2counter++;
+			}
 			break;
 	}
 	#endif
@@ -63,14 +63,21 @@ typedef struct
 {
 	#ifdef SOFTUART1_RX_PIN
 	struct Fifo inBuffer;
+	char inBufferData[FIFO_BUFFER_SIZE];
 	uint8_t inputFilter;
 	char inState;
+	// Set if samples of a bit in current byte did not agree, see noiseFilter.
+	char inNoise;
 	int inCounter;
 	int inCh;
+	// Receive errors, see serialGetStats.
+	uint32_t nOfFramingErrors;
+	uint32_t nOfNoiseErrors;
 	#endif
 
 	#ifdef SOFTUART1_TX_PIN
 	struct Fifo outBuffer;
+	char outBufferData[FIFO_BUFFER_SIZE];
 	char outState;
 	#if (!defined SERIAL_SOFT_HARDCODED_BAUDRATE) || (TIM2_TICKS_PER_SEC != SOFTUART1_BAUDRATE)
 	int outCounter;
@@ -24,6 +24,9 @@ Adapted for using STM32.
 
 #ifdef STM32L432xx
 // This is the Cortex M4 Lowpower version L4321
+#elif (defined __linux__)
+// Simulation on a linux PC, see "make host" and linuxSim.c.
+// Same configuration as the STM32L432 target is used.
 #elif (defined STM32F103C8Tx)
 #warning Not implemented yet
 #else
@@ -38,6 +41,27 @@ Adapted for using STM32.
 // Support for Low Power Uart (LPUART)
 //#define LPUART1_BAUDRATE 9600
 
+// Size in bytes of the send and receive buffers (Fifo) of USART1 and
+// USART2, must be a power of two. Usart1 is the opto link, messages
+// are forwarded on it so it needs more than the others.
+// Other ports use FIFO_BUFFER_SIZE, see fifo.h.
+#define USART1_FIFO_SIZE 512
+#define USART2_FIFO_SIZE 256
+
+// Send on USART1 and USART2 using DMA (DMA1 channel 4 and 7).
+// There is then one interrupt per block of bytes instead of one per byte,
+// see serialDma.h. Comment out to use the TXE interrupt instead.
+#define USART1_TX_DMA
+#define USART2_TX_DMA
+
+// Receive on USART1 and USART2 using circular DMA (DMA1 channel 5 and 6)
+// into a buffer of this many bytes. No interrupt per byte, the idle line
+// interrupt marks the end of a burst, see serialDma.h. The buffer must hold
+// what arrives while main loop is busy, at 115200 baud 512 bytes is 44 ms.
+// Comment out to use the RXNE interrupt and a Fifo instead.
+#define USART1_RX_DMA_SIZE 512
+#define USART2_RX_DMA_SIZE 256
+
 // Usart1 is the one connected to our opto link
 // It is used for receiving commands.
 #define COMMAND_ON_USART1
@@ -67,6 +91,33 @@ Adapted for using STM32.
 #define DEBUG_DECODE_DBF
 
 
+// Send the voltage, temperature and current status messages in batches.
+// Readings are collected during this many milli seconds and then sent
+// together as one BATCH_STATUS_MSG, see messageBatchAdd.
+// Comment the line out to send each reading in a message of its own.
+//#define STATUS_BATCH_MS 100
+
+
+// Send voltage, temperature and current status messages as differences
+// from the previous message. Only every STATUS_DELTA_KEYFRAME:th message is
+// sent with full values, see DELTA_STATUS_MSG. This gives shorter messages
+// but a receiver that misses a message gets wrong values until next keyframe.
+//#define STATUS_DELTA_KEYFRAME 10
+
+
+// Send strings as compact strings, common words are then sent as one code
+// (2 bytes), see DBF_CSTR_BEGIN_CODE in Dbf.c. Receivers need to be
+// updated to know compact strings before this is used.
+//#define DBF_COMPACT_STRINGS
+
+
+// Send the counters of the serial ports (see SerialStats) in a
+// SERIAL_STATS_STATUS_MSG this often, one message per port.
+// They can also be read as parameters (SERIAL_RX_BYTES etc).
+// Comment the line out to not send them.
+#define SERIAL_STATS_INTERVAL_S 60
+
+
 // It may be useful to report all parameter changes.
 // If not needed comment the line below out.
 //#define REPORT_PARAMETER_CHANGES
@@ -148,6 +199,18 @@ ADC1_IN16 PB1
 //#define FORWARD_LPUART1_TO_SOFTUART1
 //#define FORWARD_LPUART1_TO_LPUART1
 
+// Forwarded messages are given a TTL (hop count), see 0000001b in Dbf.c.
+// Messages received without one get FORWARD_TTL. Messages with TTL zero
+// are not forwarded.
+#define FORWARD_TTL 8
+
+// A DBF message is not forwarded again if same message (same CRC) was
+// forwarded less than FORWARD_FILTER_MS ago and its TTL is not higher than
+// what it was forwarded with. So messages echoed back are dropped but a
+// command sent again is forwarded, see forwardFilter.h. Needs FORWARD_TTL.
+#define FORWARD_FILTER_SIZE 16
+#define FORWARD_FILTER_MS 2000
+
 
 #ifdef FAN1_APIN
 #define PORTS_GPIO_APIN FAN1_APIN
@@ -172,6 +235,21 @@ ADC1_IN16 PB1
 #endif
 #endif
 
+// If usart2 shall receive using DMA its baudrate must be set.
+#if (defined USART2_RX_DMA_SIZE) && (!defined USART2_BAUDRATE)
+#error
+#endif
+
+// The forward filter uses the TTL to tell an echo from a message sent again.
+#if (defined FORWARD_FILTER_SIZE) && (!defined FORWARD_TTL)
+#error
+#endif
+
+// Fifo sizes must be a power of two.
+#if (USART1_FIFO_SIZE & (USART1_FIFO_SIZE - 1)) || (USART2_FIFO_SIZE & (USART2_FIFO_SIZE - 1))
+#error
+#endif
+
 // If soft uart is used its baudrate must be set.
 #ifdef SCPI_ON_SOFTUART1
 #ifndef SOFTUART1_BAUDRATE
@@ -13,6 +13,7 @@ Created.
 Henrik Bjorkman
 
 */
+#include <stddef.h>
 #include "cfg.h"
 //#include <string.h>
 
@@ -33,17 +34,20 @@ Henrik Bjorkman
 #include "serialDev.h"
 #include "translator.h"
 #include "mainSeconds.h"
+#include "messageUtilities.h"
+#include "messageSchema.h"
+#include "forwardFilter.h"
 
 
 
 #ifdef COMMAND_ON_LPUART1
-static DbfReceiver cmdLine0;
+static DbfReceiveQueue cmdLine0;
 #endif
 
-static DbfReceiver cmdLine1;
+static DbfReceiveQueue cmdLine1;
 
 #ifdef COMMAND_ON_USART2
-static DbfReceiver cmdLine2;
+static DbfReceiveQueue cmdLine2;
 #endif
 
 
@@ -61,13 +65,28 @@ static DbfReceiver cmdLine2;
 #define CMD_MAX_TEMP_HZ 1360
 
 
-static void forwardMessage(int usartDev, const DbfReceiver* dbfReceiver)
+#ifdef FORWARD_FILTER_SIZE
+// Recently forwarded messages, see forwardFilterIsLoop.
+static ForwardFilter forwardFilter;
+#endif
+
+
+// The message (after its TTL if any) is sent after the given networking
+// options (the new TTL).
+static void forwardMessage(int usartDev, const DbfFrame* dbfFrame, const DbfSerializer *options, unsigned int nextPos)
 {
-	const char *msgPtr=dbfReceiver->buffer;
-	const int msgLen=dbfReceiver->msgSize;
-	serialPutChar(usartDev, DBF_BEGIN_CODEID);
-	serialWrite(usartDev, msgPtr, msgLen);
-	serialPutChar(usartDev, DBF_END_CODEID);
+	const char begin = DBF_BEGIN_CODEID;
+	const char end = DBF_END_CODEID;
+	const SerialSpan spans[] = {
+		{&begin, 1},
+		{DbfSerializerGetMsgPtr(options), DbfSerializerGetMsgLen(options)},
+		{(const char *)dbfFrame->msgPtr + nextPos, dbfFrame->msgSize - nextPos},
+		{&end, 1},
+	};
+
+	// All or nothing, a frame that does not fit is dropped (and counted)
+	// rather than sent partly.
+	serialWriteFrame(usartDev, spans, SIZEOF_ARRAY(spans));
 }
 
 
@@ -82,77 +101,106 @@ static int64_t LastParameterLogTime = 0;
 /**
  * Used to send a message received from one serial port to another.
  */
-static void forwardMessageToOthers(int receivedFromUsartDev, const DbfReceiver* dbfReceiver)
+static void forwardMessageToOthers(int receivedFromUsartDev, const DbfFrame* dbfFrame)
 {
 	// Depending on which USART device the message was received on, forward to the other.
 
-	/*if (isAlreadyForwarded(dbfReceiver))
+	if (dbfFrame->isDbf && (dbfFrame->validResult != DBF_VALID))
 	{
-		// Don,t forward this, its same as a previous message.
+		// Don't spend bandwidth on a corrupt message. This was checked when
+		// the message was received so no need to decode it here.
+		return;
 	}
-	else*/
+
+	// The TTL is decremented (not part of CRC so the rest is sent as received).
+	char buf[8];
+	DbfSerializer options;
+	DbfSerializerInitBuffer(&options, buf, sizeof(buf));
+	unsigned int nextPos = 0;
+	#ifdef FORWARD_TTL
+	if (dbfFrame->isDbf)
 	{
-		switch(receivedFromUsartDev)
+		int ttl = DbfFrameReadTtl(dbfFrame, &nextPos);
+		if (ttl == 0)
+		{
+			// Don't forward this, it has been forwarded as many times as it may.
+			return;
+		}
+		if (ttl < 0)
+		{
+			ttl = FORWARD_TTL;
+		}
+		#ifdef FORWARD_FILTER_SIZE
+		if (forwardFilterIsLoop(&forwardFilter, DbfFrameHash(dbfFrame), ttl, systemGetSysTimeMs()))
 		{
-			case DEV_USART1:
-				#ifdef FORWARD_USART1_TO_USART1
-				forwardMessage(DEV_USART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART1_TO_USART2
-				forwardMessage(DEV_USART2, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART1_TO_SOFTUART1
-				forwardMessage(DEV_SOFTUART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART1_TO_LPUART1
-				forwardMessage(DEV_LPUART1, dbfReceiver);
-				#endif
-				break;
-			case DEV_USART2:
-				#ifdef FORWARD_USART2_TO_USART1
-				forwardMessage(DEV_USART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART2_TO_USART2
-				forwardMessage(DEV_USART2, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART2_TO_SOFTUART1
-				forwardMessage(DEV_SOFTUART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_USART2_TO_LPUART1
-				forwardMessage(DEV_LPUART1, dbfReceiver);
-				#endif
-				break;
-			case DEV_SOFTUART1:
-				#ifdef FORWARD_SOFTUART1_TO_USART1
-				forwardMessage(DEV_USART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_SOFTUART1_TO_USART2
-				forwardMessage(DEV_USART2, dbfReceiver);
-				#endif
-				#ifdef FORWARD_SOFTUART1_TO_SOFTUART1
-				forwardMessage(DEV_SOFTUART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_SOFTUART1_TO_LPUART1
-				forwardMessage(DEV_LPUART1, dbfReceiver);
-				#endif
-				break;
-			case DEV_LPUART1:
-				#ifdef FORWARD_LPUART1_TO_USART1
-				forwardMessage(DEV_USART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_LPUART1_TO_USART2
-				forwardMessage(DEV_USART2, dbfReceiver);
-				#endif
-				#ifdef FORWARD_LPUART1_TO_SOFTUART1
-				forwardMessage(DEV_SOFTUART1, dbfReceiver);
-				#endif
-				#ifdef FORWARD_LPUART1_TO_LPUART1
-				forwardMessage(DEV_LPUART1, dbfReceiver);
-				#endif
-				break;
-			default:
-				break;
+			// Don't forward this, it is our own copy of the message coming back.
+			return;
 		}
+		#endif
+		DbfSerializerWriteTtl(&options, ttl - 1);
+	}
+	#endif
+
+	switch(receivedFromUsartDev)
+	{
+		case DEV_USART1:
+			#ifdef FORWARD_USART1_TO_USART1
+			forwardMessage(DEV_USART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART1_TO_USART2
+			forwardMessage(DEV_USART2, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART1_TO_SOFTUART1
+			forwardMessage(DEV_SOFTUART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART1_TO_LPUART1
+			forwardMessage(DEV_LPUART1, dbfFrame, &options, nextPos);
+			#endif
+			break;
+		case DEV_USART2:
+			#ifdef FORWARD_USART2_TO_USART1
+			forwardMessage(DEV_USART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART2_TO_USART2
+			forwardMessage(DEV_USART2, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART2_TO_SOFTUART1
+			forwardMessage(DEV_SOFTUART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_USART2_TO_LPUART1
+			forwardMessage(DEV_LPUART1, dbfFrame, &options, nextPos);
+			#endif
+			break;
+		case DEV_SOFTUART1:
+			#ifdef FORWARD_SOFTUART1_TO_USART1
+			forwardMessage(DEV_USART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_SOFTUART1_TO_USART2
+			forwardMessage(DEV_USART2, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_SOFTUART1_TO_SOFTUART1
+			forwardMessage(DEV_SOFTUART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_SOFTUART1_TO_LPUART1
+			forwardMessage(DEV_LPUART1, dbfFrame, &options, nextPos);
+			#endif
+			break;
+		case DEV_LPUART1:
+			#ifdef FORWARD_LPUART1_TO_USART1
+			forwardMessage(DEV_USART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_LPUART1_TO_USART2
+			forwardMessage(DEV_USART2, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_LPUART1_TO_SOFTUART1
+			forwardMessage(DEV_SOFTUART1, dbfFrame, &options, nextPos);
+			#endif
+			#ifdef FORWARD_LPUART1_TO_LPUART1
+			forwardMessage(DEV_LPUART1, dbfFrame, &options, nextPos);
+			#endif
+			break;
+		default:
+			break;
 	}
 }
 
@@ -161,6 +209,36 @@ static void forwardMessageToOthers(int receivedFromUsartDev, const DbfReceiver*
 
 
 
+// There is one parameter code per serial port, see SERIAL_RX_BYTES.
+#if SERIAL_NOF_DEV != SERIAL_STATS_NOF_PORTS
+#error
+#endif
+
+// Gives the value of one of the SERIAL_* parameters.
+static int64_t getSerialStatsParameterValue(PARAMETER_CODES parId)
+{
+	const int usartNr = (parId - SERIAL_RX_BYTES) % SERIAL_NOF_DEV;
+	SerialStats stats;
+	serialGetStats(usartNr, &stats);
+	switch(parId - usartNr)
+	{
+		case SERIAL_RX_BYTES: return stats.rxBytes;
+		case SERIAL_TX_BYTES: return stats.txBytes;
+		case SERIAL_ISR_ENTRIES: return stats.isrEntries;
+		case SERIAL_OVERRUN_ERRORS: return stats.overrunErrors;
+		case SERIAL_FRAMING_ERRORS: return stats.framingErrors;
+		case SERIAL_NOISE_ERRORS: return stats.noiseErrors;
+		case SERIAL_RX_HIGH_WATER: return stats.rxHighWater;
+		case SERIAL_TX_HIGH_WATER: return stats.txHighWater;
+		case SERIAL_RX_FULL_EVENTS: return stats.rxFullEvents;
+		case SERIAL_TX_FULL_EVENTS: return stats.txFullEvents;
+		case SERIAL_DROPPED_FRAMES: return stats.droppedFrames;
+		case SERIAL_DROPPED_BYTES: return stats.droppedBytes;
+		default: break;
+	}
+	return 0;
+}
+
 // Returns 0 if OK, nonzero otherwise.
 int64_t getParameterValue(PARAMETER_CODES parId, NOK_REASON_CODES *result)
 {
@@ -194,6 +272,10 @@ int64_t getParameterValue(PARAMETER_CODES parId, NOK_REASON_CODES *result)
 		case MEASURED_LEAK_AC_CURRENT_MA: return currentGetAcCurrent_mA();
 		#endif
 		default:
+			if ((parId >= SERIAL_RX_BYTES) && (parId < SERIAL_STATS_END))
+			{
+				return getSerialStatsParameterValue(parId);
+			}
 			if (result!=NULL)
 			{
 				*result = NOK_UNKOWN_PARAMETER;
@@ -204,47 +286,41 @@ int64_t getParameterValue(PARAMETER_CODES parId, NOK_REASON_CODES *result)
 }
 
 
-static void processReceivedMessage(int usartDev, const DbfReceiver* dbfReceiver)
+static void processReceivedMessage(int usartDev, const DbfFrame* dbfFrame)
 {
 	// Typically command interpreter would be called here.
 	// but in this case no commands are supported att all.
 	// Just forward the message.
-	forwardMessageToOthers(usartDev, dbfReceiver);
+	forwardMessageToOthers(usartDev, dbfFrame);
 }
 
-void cmdCheckSerialPort(int usartDev, DbfReceiver* dbfReceiver)
+void cmdCheckSerialPort(int usartDev, DbfReceiveQueue* dbfReceiveQueue)
 {
-	// Check for input from serial port
-	const int16_t ch = serialGetChar(usartDev);
-	if (ch>=0)
+	// Check for input from serial port, take all that is available.
+	// The bytes are decoded where they are in the receive buffer (no copy).
+	// If the queue gets full the bytes not taken are left in the receive
+	// buffer until the queue has been emptied.
+	const char *ptr;
+	int n;
+	while ((n = serialPeek(usartDev, &ptr)) > 0)
 	{
-		//#if (defined __arm__)
-		//usartPrint(DEV_USART2, "ch ");
-		//usartPrintInt64(DEV_USART2, ch);
-		//usartPrint(DEV_USART2, "\n");
-		//#endif
-
-		const char r = DbfReceiverProcessCh(dbfReceiver, ch);
-
-		if (r > 0)
-		{
-			// A full message or line has been received.
-
-			processReceivedMessage(usartDev, dbfReceiver);
-
-			DbfReceiverInit(dbfReceiver);
-		}
-		else if (r == 0)
-		{
-			// We do not yet have a full message.
-		}
-		else
+		// Complete messages are put in the queue.
+		unsigned int nOfBytesUsed;
+		const int r = DbfReceiveQueueProcessSpan(dbfReceiveQueue, (const unsigned char*)ptr, n, &nOfBytesUsed);
+		serialSkip(usartDev, nOfBytesUsed);
+		if (r < 0)
 		{
 			debug_print(LOG_PREFIX "something wrong" LOG_SUFIX);
 			logInt1(CMD_INCORRECT_DBF_RECEIVED);
-			DbfReceiverInit(dbfReceiver);
 		}
 
+		// Process the messages received so far, all of them in one go.
+		const DbfFrame* dbfFrame;
+		while ((dbfFrame = DbfReceiveQueuePeek(dbfReceiveQueue)) != NULL)
+		{
+			processReceivedMessage(usartDev, dbfFrame);
+			DbfReceiveQueueRemove(dbfReceiveQueue);
+		}
 	}
 }
 
@@ -270,15 +346,15 @@ void cmdFastTick(void)
 void cmdMediumTick(void)
 {
 	#ifdef COMMAND_ON_USART1
-	DbfReceiverTick(&cmdLine1, 1);
+	DbfReceiverTick(&cmdLine1.receiver, 1);
 	#endif
 
 	#ifdef COMMAND_ON_LPUART1
-	DbfReceiverTick(&cmdLine0, 1);
+	DbfReceiverTick(&cmdLine0.receiver, 1);
 	#endif
 
 	#ifdef COMMAND_ON_USART2
-	DbfReceiverTick(&cmdLine2, 1);
+	DbfReceiverTick(&cmdLine2.receiver, 1);
 	#endif
 
 	#ifdef REPORT_PARAMETER_CHANGES
@@ -308,20 +384,52 @@ void cmdMediumTick(void)
 
 
 
+#ifdef SERIAL_STATS_INTERVAL_S
+static int32_t serialStatsSeconds = 0;
+
+void cmdSecondsTick(void)
+{
+	if (++serialStatsSeconds < SERIAL_STATS_INTERVAL_S)
+	{
+		return;
+	}
+	serialStatsSeconds = 0;
+
+	for(int usartNr = 0; usartNr < SERIAL_NOF_DEV; usartNr++)
+	{
+		SerialStats s;
+		serialGetStats(usartNr, &s);
+		if ((s.rxBytes == 0) && (s.txBytes == 0) && (s.droppedBytes == 0))
+		{
+			// Port not in use.
+			continue;
+		}
+		statusMsgSendSerialStats(&messageDbfTmpBuffer, usartNr, s.rxBytes, s.txBytes,
+			s.isrEntries, s.overrunErrors, s.framingErrors, s.noiseErrors,
+			s.rxHighWater, s.txHighWater, s.rxFullEvents, s.txFullEvents,
+			s.droppedFrames, s.droppedBytes);
+	}
+}
+#endif
+
 void cmdInit(void)
 {
 	logInt1(CMD_INIT);
 
 	#ifdef COMMAND_ON_USART1
-	DbfReceiverInit(&cmdLine1);
+	DbfReceiveQueueInit(&cmdLine1);
 	#endif
 
 	#ifdef COMMAND_ON_LPUART1
-	DbfReceiverInit(&cmdLine0);
+	DbfReceiveQueueInit(&cmdLine0);
 	#endif
 
 	#ifdef COMMAND_ON_USART2
-	DbfReceiverInit(&cmdLine2);
+	DbfReceiveQueueInit(&cmdLine2);
+	#endif
+
+	#ifdef FORWARD_FILTER_SIZE
+	forwardFilterInit(&forwardFilter, systemGetSysTimeMs());
 	#endif
 
 	// cmdInit must be called after eepromLoad for this to work.
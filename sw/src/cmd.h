@@ -33,5 +33,11 @@ void cmdFastTick(void);
 // This shall be called once per second.
 void cmdMediumTick(void);
 
+#ifdef SERIAL_STATS_INTERVAL_S
+// Sends SERIAL_STATS_STATUS_MSG every SERIAL_STATS_INTERVAL_S seconds.
+// This shall be called once per second.
+void cmdSecondsTick(void);
+#endif
+
 
 #endif
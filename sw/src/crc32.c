@@ -27,6 +27,7 @@ History:
 #include <stdio.h>
 #if (defined __linux__) || (defined __WIN32)
 #include <assert.h>
+#define ASSERT(c) assert(c)
 #else
 #include "mathi.h"
 #endif
@@ -193,15 +194,16 @@ static uint32_t crc32_reflect32(uint32_t in)
 
 
 /* calculates a checksumm for a buffer at address "buf" of size "size" */
-uint32_t crc32_calculate(const unsigned char *buf, int size)
+uint32_t crc32_init()
 {
   /* this crc starts with all ones. It would be possible to start with something else. */
-  uint32_t crc=0xffffffffl; 
+  return 0xffffffffl;
+}
 
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, int size)
+{
   ASSERT(buf);
 
-  D(printf("crc32_calculate: %s %d\n",buf,size);)
-
   /* Update the checksum for all bytes in the buffer. */
   int i=0;
   for(i=0;i<size;i++)
@@ -210,6 +212,16 @@ uint32_t crc32_calculate(const unsigned char *buf, int size)
     crc = CRC32_COMPUTE(crc, CRC32_REFLECT8BIT(*buf++));
   }
 
+  return(crc);
+}
+
+uint32_t crc32_update_byte(uint32_t crc, unsigned char ch)
+{
+  return CRC32_COMPUTE(crc, CRC32_REFLECT8BIT(ch));
+}
+
+uint32_t crc32_final(uint32_t crc)
+{
   /* reflect the bits in the checksum */
   crc=CRC32_REFLECT32BIT(crc);
 
@@ -217,7 +229,13 @@ uint32_t crc32_calculate(const unsigned char *buf, int size)
   crc=~crc;
 
   return(crc);
+}
+
+uint32_t crc32_calculate(const unsigned char *buf, int size)
+{
+  D(printf("crc32_calculate: %s %d\n",buf,size);)
 
+  return crc32_final(crc32_update(crc32_init(), buf, size));
 }
 
 /***************************** end of file ***********************************/
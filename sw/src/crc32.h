@@ -18,4 +18,14 @@ History:
 /* returns a 4 byte checksum for the buffer. */
 uint32_t crc32_calculate(const unsigned char *buf, int size);
 
+/* Same as crc32_calculate but the buffer can be given in parts:
+   crc = crc32_init(), then crc = crc32_update(crc, ...) for each part
+   and finally crc32_final(crc) gives the checksum. */
+uint32_t crc32_init();
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, int size);
+uint32_t crc32_final(uint32_t crc);
+
+/* Same as crc32_update for one byte. */
+uint32_t crc32_update_byte(uint32_t crc, unsigned char ch);
+
 #endif
@@ -27,6 +27,7 @@ Henrik Bjorkman
 #include "log.h"
 #include "messageNames.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 #include "systemInit.h"
 #include "translator.h"
 
@@ -55,11 +56,7 @@ static void sendCurrentMessage(int cur_mA)
 	// This will typically be sent on usart1 (opto link)
 	// This needs to match the unpacking in externalLeakSensorProcessMsg.
 	// If changes are made here check if that needs to be changed also.
-	messageInitAndAddCategoryAndSender(&messageDbfTmpBuffer, STATUS_CATEGORY);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, LEAK_CURRENT_STATUS_MSG);
-	DbfSerializerWriteInt64(&messageDbfTmpBuffer, systemGetSysTimeMs());
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, cur_mA);
-	messageSendDbf(&messageDbfTmpBuffer);
+	statusMsgSendLeakCurrent(&messageDbfTmpBuffer, systemGetSysTimeMs(), cur_mA);
 }
 
 
@@ -0,0 +1,575 @@
+/*
+dbfBench.c
+
+A linux program that checks DbfScan.c against Dbf.c and compares their
+speed. Random messages are encoded with DbfSerializer, then decoded with
+DbfScan and the result compared with what was encoded. After that a
+stream of such messages is decoded by both DbfReceiveQueue/DbfUnserializer
+and DbfScan and the time each takes is measured.
+
+Build with "make dbf_bench", run with "./dbf_bench [seed]".
+Returns non zero if DbfScan did not give the same result.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Dbf.h"
+#include "DbfScan.h"
+
+// Number of different messages in the stream used for measuring.
+#define BENCH_N_OF_MESSAGES 4096
+// Number of times the stream is decoded.
+#define BENCH_N_OF_ROUNDS 200
+// Bytes given to DbfReceiveQueue at a time, like a DMA buffer would.
+#define BENCH_CHUNK_SIZE 32
+// Messages are kept a bit shorter than what DbfReceiver can take.
+#define BENCH_MAX_MSG_SIZE 90
+
+#define BENCH_MAX_STRING 48
+#define BENCH_MAX_ARRAY 8
+
+// Dbf.c needs this, on target it is in the timer driver.
+int64_t buf_time_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// What a field was encoded with.
+typedef struct
+{
+	DbfScanKindEnum kind;
+	int64_t value;
+	int32_t exponent;
+	char str[BENCH_MAX_STRING];
+	uint8_t elementSize;
+	uint8_t nOfElements;
+	int32_t elements[BENCH_MAX_ARRAY];
+} BenchField;
+
+#define BENCH_MAX_FIELDS 64
+
+typedef struct
+{
+	unsigned char buffer[DBF_SERIALIZER_BUFFER_SIZE];
+	unsigned int size;
+	unsigned int nOfFields;
+	BenchField fields[BENCH_MAX_FIELDS];
+} BenchMessage;
+
+static uint64_t randomState = 0x2545F4914F6CDD1DULL;
+static int nOfErrors = 0;
+// Results of decoding are put here so that the compiler does not skip the work.
+volatile int64_t benchSink;
+
+static uint64_t benchRandom()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState;
+}
+
+// A random number of random size, small ones are more common.
+static int64_t benchRandomInt()
+{
+	switch(benchRandom() % 8)
+	{
+		case 0: return INT64_MAX;
+		case 1: return INT64_MIN;
+		case 2: return (int64_t)benchRandom();
+		case 3: return (int32_t)benchRandom();
+		case 4: return (int16_t)benchRandom();
+		default: return (int8_t)benchRandom() / 4;
+	}
+}
+
+static void benchRandomString(char *str, int compact)
+{
+	static const char* const words[] = {"EIT ", "Dielectric", " test ", "system", "SCPI", "buffer", "ok", " "};
+	const unsigned int n = benchRandom() % 6;
+	int c = 0;
+	str[0] = 0;
+	for(unsigned int i = 0; i < n; i++)
+	{
+		if (compact && (benchRandom() % 2))
+		{
+			const char *w = words[benchRandom() % (sizeof(words) / sizeof(words[0]))];
+			if (c + strlen(w) < 20)
+			{
+				strcpy(str + c, w);
+				c += strlen(w);
+			}
+		}
+		else
+		{
+			str[c++] = ' ' + benchRandom() % 95;
+			str[c] = 0;
+		}
+	}
+}
+
+static void benchRandomMessage(BenchMessage *m)
+{
+	DbfSerializer dbfSerializer;
+	DbfSerializerInitBuffer(&dbfSerializer, (char*)m->buffer, sizeof(m->buffer));
+	m->nOfFields = 0;
+
+	if (benchRandom() % 4 == 0)
+	{
+		DbfSerializerWriteTtl(&dbfSerializer, benchRandom() % 300);
+	}
+
+	const unsigned int n = 1 + benchRandom() % 12;
+	while ((m->nOfFields < n) && (DbfSerializerGetMsgLen(&dbfSerializer) < BENCH_MAX_MSG_SIZE - 40))
+	{
+		BenchField *f = &m->fields[m->nOfFields++];
+		memset(f, 0, sizeof(*f));
+		switch(benchRandom() % 8)
+		{
+			case 0:
+				f->kind = DbfScanStringKind;
+				benchRandomString(f->str, 0);
+				DbfSerializerWriteString(&dbfSerializer, f->str);
+				break;
+			case 1:
+				f->kind = DbfScanStringKind;
+				benchRandomString(f->str, 1);
+				DbfSerializerWriteCompactString(&dbfSerializer, f->str);
+				break;
+			case 2:
+				f->kind = DbfScanDecimalKind;
+				f->value = (int32_t)benchRandom();
+				f->exponent = (int)(benchRandom() % 20) - 10;
+				DbfSerializerWriteDecimal(&dbfSerializer, f->value, f->exponent);
+				DbfDecimalNormalize(&f->value, &f->exponent);
+				break;
+			case 3:
+				f->kind = DbfScanArrayKind;
+				f->elementSize = 1 << (benchRandom() % 3);
+				f->nOfElements = benchRandom() % (BENCH_MAX_ARRAY + 1);
+				for(int i = 0; i < f->nOfElements; i++)
+				{
+					switch(f->elementSize)
+					{
+						case 1: f->elements[i] = (uint8_t)benchRandom(); break;
+						case 2: f->elements[i] = (int16_t)benchRandom(); break;
+						default: f->elements[i] = (int32_t)benchRandom(); break;
+					}
+				}
+				switch(f->elementSize)
+				{
+					case 1:
+					{
+						uint8_t a[BENCH_MAX_ARRAY];
+						for(int i = 0; i < f->nOfElements; i++) {a[i] = f->elements[i];}
+						DbfSerializerWriteArray8(&dbfSerializer, a, f->nOfElements);
+						break;
+					}
+					case 2:
+					{
+						int16_t a[BENCH_MAX_ARRAY];
+						for(int i = 0; i < f->nOfElements; i++) {a[i] = f->elements[i];}
+						DbfSerializerWriteArray16(&dbfSerializer, a, f->nOfElements);
+						break;
+					}
+					default:
+						DbfSerializerWriteArray32(&dbfSerializer, f->elements, f->nOfElements);
+						break;
+				}
+				break;
+			default:
+			{
+				f->kind = DbfScanIntKind;
+				// Same value again sometimes so that repetition codes are used.
+				const BenchField *prev = (m->nOfFields >= 2) ? &m->fields[m->nOfFields - 2] : NULL;
+				f->value = ((prev != NULL) && (prev->kind == DbfScanIntKind) && (benchRandom() % 2)) ? prev->value : benchRandomInt();
+				DbfSerializerWriteInt64(&dbfSerializer, f->value);
+				break;
+			}
+		}
+	}
+
+	DbfSerializerWriteCrc(&dbfSerializer);
+	if (DbfSerializerIsOverflow(&dbfSerializer))
+	{
+		printf("Serializer overflow\n");
+		nOfErrors++;
+	}
+	m->size = DbfSerializerGetMsgLen(&dbfSerializer);
+}
+
+static void benchError(const BenchMessage *m, unsigned int fieldIdx, const char *what)
+{
+	if (nOfErrors < 10)
+	{
+		printf("Mismatch in field %u: %s, message:", fieldIdx, what);
+		for(unsigned int i = 0; i < m->size; i++)
+		{
+			printf(" %02x", m->buffer[i]);
+		}
+		printf("\n");
+	}
+	nOfErrors++;
+}
+
+// Each code decoded by DbfScanDecodeCode shall be same as in DbfFieldIndex.
+// A number followed by a repetition code shall be in the index as many
+// times as it was repeated.
+static void benchCheckCodes(const BenchMessage *m)
+{
+	DbfFieldIndex dbfFieldIndex;
+	DbfFieldIndexInit(&dbfFieldIndex, m->buffer, m->size);
+	const unsigned char *ptr = m->buffer;
+	const unsigned char *end = m->buffer + m->size;
+	unsigned int i = 0;
+	uint8_t prevType = DbfNCT;
+	int64_t prevValue = 0;
+	while (ptr < end)
+	{
+		uint8_t type;
+		uint64_t data;
+		const unsigned int len = DbfScanDecodeCode(ptr, end, &type, &data);
+		if ((len == 0) || (len != DbfScanCodeLength(ptr, end)))
+		{
+			benchError(m, i, "code length");
+			return;
+		}
+		ptr += len;
+
+		if ((type == DbfSCT) && ((prevType == DbfINT) || (prevType == DbfNEG)))
+		{
+			for(unsigned int n = 0; n < data + 1; n++, i++)
+			{
+				if ((DbfFieldIndexGetType(&dbfFieldIndex, i) != prevType) || (DbfFieldIndexGetInt64(&dbfFieldIndex, i) != prevValue))
+				{
+					benchError(m, i, "repeated code");
+					return;
+				}
+			}
+			continue;
+		}
+
+		const int64_t value = (type == DbfNEG) ? (int64_t)(-1 - (int64_t)data) : (int64_t)data;
+		if (type != DbfFieldIndexGetType(&dbfFieldIndex, i))
+		{
+			benchError(m, i, "code");
+			return;
+		}
+		if ((type != DbfNCT) && (value != DbfFieldIndexGetInt64(&dbfFieldIndex, i)))
+		{
+			benchError(m, i, "code data");
+			return;
+		}
+		prevType = type;
+		prevValue = value;
+		i++;
+	}
+	if (i != DbfFieldIndexGetNOfCodes(&dbfFieldIndex))
+	{
+		benchError(m, i, "number of codes");
+	}
+}
+
+// A message with a repeated value, DbfFieldIndex shall give the same
+// numbers as DbfUnserializer and as were written.
+static void benchCheckRepeat()
+{
+	static const int64_t values[] = {7, 0, 0, 0, 9, -3, -3, 5};
+	const unsigned int nOfValues = sizeof(values) / sizeof(values[0]);
+	BenchMessage m;
+	DbfSerializer dbfSerializer;
+	DbfSerializerInitBuffer(&dbfSerializer, (char*)m.buffer, sizeof(m.buffer));
+	for(unsigned int i = 0; i < nOfValues; i++)
+	{
+		DbfSerializerWriteInt64(&dbfSerializer, values[i]);
+	}
+	m.size = DbfSerializerGetMsgLen(&dbfSerializer);
+
+	DbfFieldIndex dbfFieldIndex;
+	DbfFieldIndexInit(&dbfFieldIndex, m.buffer, m.size);
+	if (DbfFieldIndexGetNOfCodes(&dbfFieldIndex) != nOfValues)
+	{
+		benchError(&m, DbfFieldIndexGetNOfCodes(&dbfFieldIndex), "number of repeated codes");
+		return;
+	}
+
+	DbfSerializerWriteCrc(&dbfSerializer);
+	m.size = DbfSerializerGetMsgLen(&dbfSerializer);
+	DbfUnserializer dbfUnserializer;
+	DbfUnserializerInit(&dbfUnserializer, m.buffer, m.size);
+	for(unsigned int i = 0; i < nOfValues; i++)
+	{
+		const int64_t u = DbfUnserializerReadInt64(&dbfUnserializer);
+		if ((DbfFieldIndexGetInt64(&dbfFieldIndex, i) != values[i]) || (u != values[i]) ||
+			(DbfFieldIndexGetInt32(&dbfFieldIndex, i) != values[i]) || (DbfFieldIndexGetType(&dbfFieldIndex, i) != ((values[i] < 0) ? DbfNEG : DbfINT)))
+		{
+			benchError(&m, i, "repeated value");
+			return;
+		}
+	}
+}
+
+// DbfScanner shall give the fields that were encoded.
+static void benchCheckFields(const BenchMessage *m)
+{
+	DbfScanner dbfScanner;
+	DbfScanField dbfScanField;
+	if (DbfScannerInit(&dbfScanner, m->buffer, m->size) != DBF_OK_CRC)
+	{
+		benchError(m, 0, "CRC");
+		return;
+	}
+
+	unsigned int i = 0;
+	while (DbfScanNext(&dbfScanner, &dbfScanField) != DbfScanEndKind)
+	{
+		const BenchField *f = &m->fields[i];
+		if ((i >= m->nOfFields) || (dbfScanField.kind != f->kind))
+		{
+			benchError(m, i, "kind");
+			return;
+		}
+		switch(f->kind)
+		{
+			case DbfScanIntKind:
+				for(unsigned int n = 0; n < dbfScanField.count; n++)
+				{
+					if ((i + n >= m->nOfFields) || (m->fields[i + n].value != dbfScanField.value))
+					{
+						benchError(m, i, "int");
+						return;
+					}
+				}
+				i += dbfScanField.count - 1;
+				break;
+			case DbfScanStringKind:
+			{
+				char str[BENCH_MAX_STRING];
+				DbfScanFieldGetString(&dbfScanField, str, sizeof(str));
+				if (strcmp(str, f->str) != 0)
+				{
+					benchError(m, i, "string");
+					return;
+				}
+				break;
+			}
+			case DbfScanDecimalKind:
+				if ((dbfScanField.value != f->value) || (dbfScanField.exponent != f->exponent))
+				{
+					benchError(m, i, "decimal");
+					return;
+				}
+				break;
+			case DbfScanArrayKind:
+				if ((dbfScanField.array.elementSize != f->elementSize) || (DbfArrayGetNOfElements(&dbfScanField.array) != f->nOfElements))
+				{
+					benchError(m, i, "array size");
+					return;
+				}
+				for(int n = 0; n < f->nOfElements; n++)
+				{
+					const int32_t e = (f->elementSize == 1) ? DbfArrayGetUint8(&dbfScanField.array, n) :
+						(f->elementSize == 2) ? DbfArrayGetInt16(&dbfScanField.array, n) : DbfArrayGetInt32(&dbfScanField.array, n);
+					if (e != f->elements[n])
+					{
+						benchError(m, i, "array");
+						return;
+					}
+				}
+				break;
+			default:
+				benchError(m, i, "unexpected");
+				return;
+		}
+		i++;
+	}
+	if (i != m->nOfFields)
+	{
+		benchError(m, i, "missing fields");
+	}
+
+	// A message with a bad CRC shall give no fields.
+	// Networking options are not covered by the CRC so change something after those.
+	DbfScannerInit(&dbfScanner, m->buffer, m->size);
+	const unsigned int bodyPos = dbfScanner.pos - m->buffer;
+	BenchMessage bad = *m;
+	bad.buffer[bodyPos + benchRandom() % (bad.size - 1 - bodyPos)] ^= 0x40;
+	if ((DbfScannerInit(&dbfScanner, bad.buffer, bad.size) == DBF_OK_CRC) || (DbfScanNext(&dbfScanner, &dbfScanField) != DbfScanEndKind))
+	{
+		benchError(&bad, 0, "bad CRC not detected");
+	}
+}
+
+static double benchTimeS()
+{
+	return buf_time_us() / 1000000.0;
+}
+
+// Decode all messages in stream using DbfReceiveQueue and DbfUnserializer.
+// Returns a sum of all numbers so the work is not optimized away.
+static int64_t benchDecodeReceiveQueue(const unsigned char *stream, unsigned int size, unsigned int *nOfMsg)
+{
+	static DbfReceiveQueue dbfReceiveQueue;
+	DbfReceiveQueueInit(&dbfReceiveQueue);
+	int64_t sum = 0;
+	unsigned int pos = 0;
+	while (pos < size)
+	{
+		const unsigned int len = (size - pos < BENCH_CHUNK_SIZE) ? (size - pos) : BENCH_CHUNK_SIZE;
+		unsigned int nOfBytesUsed;
+		DbfReceiveQueueProcessSpan(&dbfReceiveQueue, stream + pos, len, &nOfBytesUsed);
+		pos += nOfBytesUsed;
+		const DbfFrame *dbfFrame;
+		while ((dbfFrame = DbfReceiveQueuePeek(&dbfReceiveQueue)) != NULL)
+		{
+			DbfUnserializer dbfUnserializer;
+			if (DbfUnserializerInitFromFrame(&dbfUnserializer, dbfFrame) == DBF_OK_CRC)
+			{
+				(*nOfMsg)++;
+				while (!DbfUnserializerReadIsNextEnd(&dbfUnserializer))
+				{
+					if (DbfUnserializerReadIsNextString(&dbfUnserializer))
+					{
+						char str[BENCH_MAX_STRING];
+						sum += DbfUnserializerReadString(&dbfUnserializer, str, sizeof(str));
+					}
+					else if (DbfUnserializerReadIsNextDecimal(&dbfUnserializer))
+					{
+						int64_t mantissa;
+						int32_t exponent;
+						DbfUnserializerReadDecimal(&dbfUnserializer, &mantissa, &exponent);
+						sum += mantissa + exponent;
+					}
+					else if (DbfUnserializerReadIsNextArray(&dbfUnserializer))
+					{
+						DbfArray dbfArray;
+						DbfUnserializerReadArray(&dbfUnserializer, &dbfArray);
+						sum += DbfArrayGetNOfElements(&dbfArray);
+					}
+					else
+					{
+						sum += DbfUnserializerReadInt64(&dbfUnserializer);
+					}
+				}
+			}
+			DbfReceiveQueueRemove(&dbfReceiveQueue);
+		}
+	}
+	return sum;
+}
+
+// Same as benchDecodeReceiveQueue but using DbfScan.
+static int64_t benchDecodeScan(const unsigned char *stream, unsigned int size, unsigned int *nOfMsg)
+{
+	const unsigned char *ptr = stream;
+	const unsigned char *end = stream + size;
+	int64_t sum = 0;
+	for(;;)
+	{
+		const unsigned char *begin = DbfScanFindDelimiter(ptr, end);
+		if ((begin == end) || (*begin != DBF_BEGIN_CODEID))
+		{
+			if (begin == end)
+			{
+				break;
+			}
+			ptr = begin + 1;
+			continue;
+		}
+		const unsigned char *msgEnd = DbfScanFindDelimiter(begin + 1, end);
+		if ((msgEnd == end) || (*msgEnd != DBF_END_CODEID))
+		{
+			ptr = msgEnd;
+			continue;
+		}
+		ptr = msgEnd + 1;
+
+		DbfScanner dbfScanner;
+		DbfScanField dbfScanField;
+		if (DbfScannerInit(&dbfScanner, begin + 1, msgEnd - begin - 1) != DBF_OK_CRC)
+		{
+			continue;
+		}
+		(*nOfMsg)++;
+		while (DbfScanNext(&dbfScanner, &dbfScanField) != DbfScanEndKind)
+		{
+			switch(dbfScanField.kind)
+			{
+				case DbfScanStringKind:
+				{
+					char str[BENCH_MAX_STRING];
+					sum += DbfScanFieldGetString(&dbfScanField, str, sizeof(str));
+					break;
+				}
+				case DbfScanDecimalKind: sum += dbfScanField.value + dbfScanField.exponent; break;
+				case DbfScanArrayKind: sum += DbfArrayGetNOfElements(&dbfScanField.array); break;
+				default: sum += dbfScanField.value * dbfScanField.count; break;
+			}
+		}
+	}
+	return sum;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+	{
+		randomState = strtoull(argv[1], NULL, 0) | 1;
+	}
+
+	static BenchMessage msg[BENCH_N_OF_MESSAGES];
+	static unsigned char stream[BENCH_N_OF_MESSAGES * (DBF_SERIALIZER_BUFFER_SIZE + 2)];
+	unsigned int streamSize = 0;
+
+	benchCheckRepeat();
+	for(int i = 0; i < BENCH_N_OF_MESSAGES; i++)
+	{
+		BenchMessage *m = &msg[i];
+		benchRandomMessage(m);
+		benchCheckCodes(m);
+		benchCheckFields(m);
+
+		stream[streamSize++] = DBF_BEGIN_CODEID;
+		memcpy(stream + streamSize, m->buffer, m->size);
+		streamSize += m->size;
+		stream[streamSize++] = DBF_END_CODEID;
+	}
+	printf("Checked %d messages, %d errors\n", BENCH_N_OF_MESSAGES, nOfErrors);
+
+	unsigned int nOfMsgQueue = 0;
+	unsigned int nOfMsgScan = 0;
+	int64_t sumQueue = 0;
+	int64_t sumScan = 0;
+
+	double t0 = benchTimeS();
+	for(int r = 0; r < BENCH_N_OF_ROUNDS; r++)
+	{
+		sumQueue += benchDecodeReceiveQueue(stream, streamSize, &nOfMsgQueue);
+	}
+	double t1 = benchTimeS();
+	for(int r = 0; r < BENCH_N_OF_ROUNDS; r++)
+	{
+		sumScan += benchDecodeScan(stream, streamSize, &nOfMsgScan);
+	}
+	double t2 = benchTimeS();
+
+	// The sums are not compared, DbfUnserializerReadIsNextString does not
+	// handle empty strings so DbfUnserializer may read some fields differently.
+	if (nOfMsgQueue != nOfMsgScan)
+	{
+		printf("Decoders differ: %u/%u messages\n", nOfMsgQueue, nOfMsgScan);
+		nOfErrors++;
+	}
+	benchSink = sumQueue + sumScan;
+
+	const double mb = (double)streamSize * BENCH_N_OF_ROUNDS / 1000000.0;
+	printf("DbfReceiveQueue: %8.1f MB/s %10.0f msg/s\n", mb / (t1 - t0), nOfMsgQueue / (t1 - t0));
+	printf("DbfScan:         %8.1f MB/s %10.0f msg/s\n", mb / (t2 - t1), nOfMsgScan / (t2 - t1));
+
+	return (nOfErrors == 0) ? 0 : 1;
+}
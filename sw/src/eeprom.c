@@ -21,12 +21,11 @@ Henrik Bjorkman
 
 #include <stdint.h>
 
-#if (defined __arm__)
-#include "systemInit.h"
-#include "serialDev.h"
-#elif (defined __linux__)
+#if (defined __linux__)
 #include <stdio.h>
 #endif
+#include "systemInit.h"
+#include "serialDev.h"
 #include "debugLog.h"
 #include "machineState.h"
 #include "messageNames.h"
@@ -1,6 +1,18 @@
 /*
 fifo.h
 
+A single producer single consumer ring buffer. Typically one of main loop
+and an interrupt (or DMA) puts bytes and the other takes them. No locking
+is needed as long as there is only one of each.
+
+Size is given per instance (so a busy port can have a larger buffer than
+others) and must be a power of two. One byte is always kept free so at
+most size-1 bytes can be stored.
+
+Bytes that do not fit are dropped and counted in nOfOverflows, they never
+overwrite bytes not yet taken. Some statistics are kept by the producer
+(bytes put, full events and high-water mark), see serialGetStats.
+
 Created 2019 by Henrik
 
 Copyright (C) 2019 Henrik Bjorkman www.eit.se/hb.
@@ -12,37 +24,78 @@ All rights reserved etc etc...
 #ifndef FIFO_H
 #define FIFO_H
 
+#include <stdint.h>
 #include "string.h"
 //#include "mathi.h"
 
 
+// Size used when nothing else is configured.
 #define FIFO_BUFFER_SIZE 256
 
+// Defines a statically allocated Fifo, size must be a power of two.
+#define FIFO_DEFINE(name, size) \
+	static char name##Buffer[size]; \
+	volatile struct Fifo name = {0, 0, (size)-1, 0, 0, 0, 0, name##Buffer}
+
 // In this FIFO entries are put in head and taken from tail.
+// Only the producer writes head and only the consumer writes tail.
 struct Fifo
 {
-	uint8_t head;
-	uint8_t tail;
-	char buffer[FIFO_BUFFER_SIZE];
+	uint16_t head;
+	uint16_t tail;
+	uint16_t mask;
+	// Number of bytes dropped since there was no room for them.
+	uint32_t nOfOverflows;
+	// Number of times a put found the fifo full (one or more bytes dropped).
+	uint32_t nOfFullEvents;
+	// Number of bytes put.
+	uint32_t nOfBytes;
+	// The most bytes that have been in the fifo at the same time.
+	uint16_t highWater;
+	char *buffer;
 };
 
 
+// Producer: buffer is written before head is moved (release).
+// Consumer: head is read before buffer is (acquire) and buffer is read
+// before tail is moved (release). Needed since compiler (and CPU) may
+// otherwise reorder the accesses.
+#define fifoRelease() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define fifoAcquire() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+
+// Size must be a power of two.
+static inline void fifoInit(volatile struct Fifo *fifoPtr, char *buffer, unsigned int size)
+{
+	fifoPtr->head = 0;
+	fifoPtr->tail = 0;
+	fifoPtr->mask = size - 1;
+	fifoPtr->nOfOverflows = 0;
+	fifoPtr->nOfFullEvents = 0;
+	fifoPtr->nOfBytes = 0;
+	fifoPtr->highWater = 0;
+	fifoPtr->buffer = buffer;
+}
 
+// Discard all bytes. Shall not be used while the other side may be using it.
+static inline void fifoClear(volatile struct Fifo *fifoPtr)
+{
+	fifoPtr->tail = fifoPtr->head;
+}
 
-static inline void fifoInit(volatile struct Fifo *fifoPtr)
+static inline int fifo_get_bytes_in_buffer(volatile struct Fifo *fifoPtr)
 {
-	memset((void*)fifoPtr, 0, sizeof(*fifoPtr));
+	return (fifoPtr->head - fifoPtr->tail) & fifoPtr->mask;
 }
 
-static inline void fifoPut(volatile struct Fifo *fifoPtr, char ch)
+static inline int fifo_free_space(volatile struct Fifo *fifoPtr)
 {
-	fifoPtr->buffer[fifoPtr->head] = ch;
-	fifoPtr->head++;
+	return fifoPtr->mask - fifo_get_bytes_in_buffer(fifoPtr);
 }
 
 static inline int fifoIsFull(volatile struct Fifo *fifoPtr)
 {
-	return (((uint8_t)(fifoPtr->head+1)) == fifoPtr->tail);
+	return (((fifoPtr->head + 1) & fifoPtr->mask) == fifoPtr->tail);
 }
 
 static inline int fifoIsEmpty(volatile struct Fifo *fifoPtr)
@@ -50,20 +103,102 @@ static inline int fifoIsEmpty(volatile struct Fifo *fifoPtr)
 	return (fifoPtr->head == fifoPtr->tail);
 }
 
+// Returns 0 if OK, -1 if full (then the byte is dropped).
+static inline int fifoPut(volatile struct Fifo *fifoPtr, char ch)
+{
+	const unsigned int mask = fifoPtr->mask;
+	const unsigned int head = fifoPtr->head;
+	const unsigned int next = (head + 1) & mask;
+	const unsigned int used = (next - fifoPtr->tail) & mask;
+	if (used == 0)
+	{
+		fifoPtr->nOfOverflows++;
+		fifoPtr->nOfFullEvents++;
+		return -1;
+	}
+	fifoPtr->buffer[head] = ch;
+	fifoRelease();
+	fifoPtr->head = next;
+	fifoPtr->nOfBytes++;
+	if (used > fifoPtr->highWater)
+	{
+		fifoPtr->highWater = used;
+	}
+	return 0;
+}
+
+// Shall only be called if not empty.
 static inline char fifoTake(volatile struct Fifo *fifoPtr)
 {
-	const char tmp = fifoPtr->buffer[fifoPtr->tail++];
+	const unsigned int tail = fifoPtr->tail;
+	fifoAcquire();
+	const char tmp = fifoPtr->buffer[tail];
+	fifoRelease();
+	fifoPtr->tail = (tail + 1) & fifoPtr->mask;
 	return tmp;
 }
 
-static inline int fifo_get_bytes_in_buffer(volatile struct Fifo *fifoPtr)
+// Put up to len bytes, returns number of bytes put. Those that did not
+// fit are counted as overflow. Copies at most two pieces (if wrapping).
+static inline int fifoPutBlock(volatile struct Fifo *fifoPtr, const char *src, int len)
 {
-	return (fifoPtr->head - fifoPtr->tail) & (FIFO_BUFFER_SIZE-1);
+	const unsigned int mask = fifoPtr->mask;
+	const unsigned int head = fifoPtr->head;
+	const unsigned int used = (head - fifoPtr->tail) & mask;
+	const unsigned int room = mask - used;
+	const unsigned int n = ((unsigned int)len < room) ? (unsigned int)len : room;
+	const unsigned int first = ((mask + 1 - head) < n) ? (mask + 1 - head) : n;
+	char *buffer = fifoPtr->buffer;
+	memcpy(buffer + head, src, first);
+	memcpy(buffer, src + first, n - first);
+	fifoRelease();
+	fifoPtr->head = (head + n) & mask;
+	fifoPtr->nOfBytes += n;
+	if (used + n > fifoPtr->highWater)
+	{
+		fifoPtr->highWater = used + n;
+	}
+	if (n < (unsigned int)len)
+	{
+		fifoPtr->nOfOverflows += len - n;
+		fifoPtr->nOfFullEvents++;
+	}
+	return n;
 }
 
-static inline int fifo_free_space(volatile struct Fifo *fifoPtr)
+// Take up to maxLen bytes, returns number of bytes taken.
+static inline int fifoTakeBlock(volatile struct Fifo *fifoPtr, char *dst, int maxLen)
+{
+	const unsigned int mask = fifoPtr->mask;
+	const unsigned int tail = fifoPtr->tail;
+	const unsigned int available = (fifoPtr->head - tail) & mask;
+	fifoAcquire();
+	const unsigned int n = ((unsigned int)maxLen < available) ? (unsigned int)maxLen : available;
+	const unsigned int first = ((mask + 1 - tail) < n) ? (mask + 1 - tail) : n;
+	const char *buffer = fifoPtr->buffer;
+	memcpy(dst, buffer + tail, first);
+	memcpy(dst + first, buffer, n - first);
+	fifoRelease();
+	fifoPtr->tail = (tail + n) & mask;
+	return n;
+}
+
+// Gives the bytes that are in one piece in the buffer, from tail and up
+// to head or the end of the buffer. Returns number of bytes at ptr.
+static inline int fifoPeekBlock(volatile struct Fifo *fifoPtr, const char **ptr)
+{
+	const unsigned int head = fifoPtr->head;
+	const unsigned int tail = fifoPtr->tail;
+	fifoAcquire();
+	*ptr = fifoPtr->buffer + tail;
+	return (head >= tail) ? (head - tail) : (fifoPtr->mask + 1 - tail);
+}
+
+// Remove n bytes, typically after fifoPeekBlock.
+static inline void fifoSkip(volatile struct Fifo *fifoPtr, int n)
 {
-	return((FIFO_BUFFER_SIZE-1)-fifo_get_bytes_in_buffer(fifoPtr));
+	fifoRelease();
+	fifoPtr->tail = (fifoPtr->tail + n) & fifoPtr->mask;
 }
 
 #endif
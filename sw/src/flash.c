@@ -65,14 +65,13 @@ History
 
 #if (defined __linux__)
 
-int8_t flashSave(const char* dataPtr, uint16_t dataSize, uint16_t offset);
+int8_t flashSave(const char* dataPtr, uint16_t dataSize, uint16_t offset)
 {
 	char fileName[80];
 	snprintf(fileName ,sizeof(fileName), "eeprom%d.bin", offset);
-	FILE *fp = fopen(fileName, "w");
+	FILE *fp = fopen(fileName, "wb");
 	if (fp!=NULL)
 	{
-		int len=dataSize;
 		for(int i=0; i<dataSize; ++i)
 		{
 			fputc(dataPtr[i], fp);
@@ -87,11 +86,11 @@ int8_t flashSave(const char* dataPtr, uint16_t dataSize, uint16_t offset);
 	return  0;
 }
 
-int8_t flashLoad(char* dataPtr, uint16_t dataSize, uint16_t offset);
+int8_t flashLoad(char* dataPtr, uint16_t dataSize, uint16_t offset)
 {
 	char fileName[80];
 	snprintf(fileName ,sizeof(fileName), "eeprom%d.bin", offset);
-	FILE *fp = fopen(fileName, "r");
+	FILE *fp = fopen(fileName, "rb");
 	if (fp!=NULL)
 	{
 		for(int i=0; i<dataSize; ++i)
@@ -0,0 +1,52 @@
+/*
+forwardFilter.c
+
+Stops forwarded messages from going around in loops, see forwardFilter.h.
+
+*/
+
+#include "forwardFilter.h"
+
+#ifdef FORWARD_FILTER_SIZE
+
+void forwardFilterInit(ForwardFilter *forwardFilter, uint32_t timeMs)
+{
+	// So that the empty entries are not taken as recently forwarded messages.
+	for(unsigned int i = 0; i < FORWARD_FILTER_SIZE; i++)
+	{
+		forwardFilter->entries[i].hash = 0;
+		forwardFilter->entries[i].timeMs = timeMs - FORWARD_FILTER_MS;
+		forwardFilter->entries[i].ttl = 0;
+	}
+	forwardFilter->next = 0;
+}
+
+int forwardFilterIsLoop(ForwardFilter *forwardFilter, uint32_t hash, int ttl, uint32_t timeMs)
+{
+	for(unsigned int i = 0; i < FORWARD_FILTER_SIZE; i++)
+	{
+		ForwardFilterEntry *entry = &forwardFilter->entries[i];
+		if ((entry->hash == hash) && ((uint32_t)(timeMs - entry->timeMs) < FORWARD_FILTER_MS))
+		{
+			if (ttl <= entry->ttl)
+			{
+				// Our own copy (or a copy of it) has come back.
+				return 1;
+			}
+			// Sent again by its origin, or came a shorter way than the copy
+			// forwarded before. Forward it and remember the higher TTL.
+			entry->timeMs = timeMs;
+			entry->ttl = ttl - 1;
+			return 0;
+		}
+	}
+
+	ForwardFilterEntry *entry = &forwardFilter->entries[forwardFilter->next];
+	entry->hash = hash;
+	entry->timeMs = timeMs;
+	entry->ttl = ttl - 1;
+	forwardFilter->next = (forwardFilter->next + 1) % FORWARD_FILTER_SIZE;
+	return 0;
+}
+
+#endif
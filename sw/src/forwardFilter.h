@@ -0,0 +1,47 @@
+/*
+forwardFilter.h
+
+Stops forwarded DBF messages from going around in loops. Messages are
+remembered (by hash) together with the TTL they were forwarded with, see
+FORWARD_TTL in cfg.h. If the same message is received again within
+FORWARD_FILTER_MS and its TTL is not higher than that, it is our own copy
+coming back (echoed or forwarded back to us by others) and it is not
+forwarded again. If its TTL is higher it was sent again by whoever
+sent it first (a repeated command) so it is forwarded as usual.
+
+Text lines have no TTL, they are not filtered.
+
+*/
+
+#ifndef FORWARD_FILTER_H
+#define FORWARD_FILTER_H
+
+#include <stdint.h>
+#include "cfg.h"
+
+#ifdef FORWARD_FILTER_SIZE
+
+typedef struct
+{
+	uint32_t hash;
+	uint32_t timeMs;
+	// TTL the message was forwarded with.
+	int ttl;
+} ForwardFilterEntry;
+
+typedef struct
+{
+	ForwardFilterEntry entries[FORWARD_FILTER_SIZE];
+	unsigned int next;
+} ForwardFilter;
+
+void forwardFilterInit(ForwardFilter *forwardFilter, uint32_t timeMs);
+
+// ttl is the TTL the message was received with (FORWARD_TTL if it had none).
+// Returns nonzero if the message shall not be forwarded. If zero is returned
+// the message is remembered as forwarded now with TTL ttl-1.
+int forwardFilterIsLoop(ForwardFilter *forwardFilter, uint32_t hash, int ttl, uint32_t timeMs);
+
+#endif
+
+#endif
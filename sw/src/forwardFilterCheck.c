@@ -0,0 +1,58 @@
+/*
+forwardFilterCheck.c
+
+A linux program that checks forwardFilter.c. A message that comes back
+with the TTL it was forwarded with (or lower) shall be dropped, the same
+message sent again by its origin (same TTL as first time) shall still be
+forwarded, as shall anything after FORWARD_FILTER_MS.
+
+Build with "make forward_filter_check", run with "./forward_filter_check".
+Returns non zero if a check failed.
+
+*/
+
+#include <stdio.h>
+#include "forwardFilter.h"
+
+static int nOfFailed = 0;
+
+static void check(const char *what, int isLoop, int expected)
+{
+	printf("%-50s %s\n", what, (isLoop == expected) ? "ok" : "FAILED");
+	if (isLoop != expected)
+	{
+		nOfFailed++;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	ForwardFilter filter;
+	uint32_t timeMs = 1000;
+	const uint32_t command = 0x12345678;
+	const uint32_t other = 0x9abcdef0;
+
+	forwardFilterInit(&filter, timeMs);
+	check("first message", forwardFilterIsLoop(&filter, command, FORWARD_TTL, timeMs), 0);
+	timeMs += 10;
+	check("echo of forwarded copy (TTL-1)", forwardFilterIsLoop(&filter, command, FORWARD_TTL - 1, timeMs), 1);
+	check("copy that went around a loop (TTL-3)", forwardFilterIsLoop(&filter, command, FORWARD_TTL - 3, timeMs), 1);
+	check("other message", forwardFilterIsLoop(&filter, other, FORWARD_TTL, timeMs), 0);
+	timeMs += 10;
+	check("same command sent again by its origin", forwardFilterIsLoop(&filter, command, FORWARD_TTL, timeMs), 0);
+	check("echo of that", forwardFilterIsLoop(&filter, command, FORWARD_TTL - 1, timeMs), 1);
+	timeMs += FORWARD_FILTER_MS;
+	check("echo after FORWARD_FILTER_MS", forwardFilterIsLoop(&filter, command, FORWARD_TTL - 1, timeMs), 0);
+
+	// More messages than there are entries, the oldest are forgotten.
+	forwardFilterInit(&filter, timeMs);
+	for(uint32_t i = 0; i <= FORWARD_FILTER_SIZE; i++)
+	{
+		forwardFilterIsLoop(&filter, i + 1, FORWARD_TTL, timeMs);
+	}
+	check("echo of latest when filter is full", forwardFilterIsLoop(&filter, FORWARD_FILTER_SIZE + 1, FORWARD_TTL - 1, timeMs), 1);
+	check("echo of forgotten message", forwardFilterIsLoop(&filter, 1, FORWARD_TTL - 1, timeMs), 0);
+
+	printf("%d failed\n", nOfFailed);
+	return (nOfFailed != 0);
+}
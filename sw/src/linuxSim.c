@@ -0,0 +1,823 @@
+/*
+linuxSim.c
+
+Run the firmware as a process on a linux PC. See linuxSim.h for
+how the simulation is configured.
+
+*/
+
+#if (defined __linux__)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+
+#include "cfg.h"
+#include "fifo.h"
+#include "miscUtilities.h"
+#include "systemInit.h"
+#include "serialDev.h"
+#include "serialDma.h"
+#include "adcDev.h"
+#include "utime.h"
+#include "linuxSim.h"
+
+
+#define SIM_NOF_PORTS 4
+
+#define SIZEOF_ARRAY(a) (sizeof(a)/sizeof(a[0]))
+
+// Largest receive DMA buffer, see USART1_RX_DMA_SIZE.
+#define SIM_DMA_RX_MAX_SIZE 1024
+
+// Largest Fifo, see USART1_FIFO_SIZE.
+#define SIM_FIFO_MAX_SIZE 1024
+
+typedef struct
+{
+	const char *envName;
+	const char *defaultConnection;
+	int fdIn;
+	int fdOut;
+	int isOpen;
+	struct Fifo in;
+	struct Fifo out;
+	char inBuffer[SIM_FIFO_MAX_SIZE];
+	char outBuffer[SIM_FIFO_MAX_SIZE];
+	// Ports that send using DMA on target (see USART1_TX_DMA) do so here
+	// also. The simulated DMA channel sends dmaLeft bytes from dmaPtr.
+	int useDmaTx;
+	SerialDmaTx dmaTx;
+	const char *dmaPtr;
+	unsigned int dmaLeft;
+	// Ports that receive using DMA (see USART1_RX_DMA_SIZE) do so here also.
+	// Simulated DMA writes into dmaRxBuffer at dmaRxWritePos.
+	int useDmaRx;
+	SerialDmaRx dmaRx;
+	unsigned int dmaRxWritePos;
+	char dmaRxBuffer[SIM_DMA_RX_MAX_SIZE];
+} LinuxSimPort;
+
+static LinuxSimPort linuxSimPorts[SIM_NOF_PORTS] = {
+	{"SIM_LPUART1", "none", -1, -1, 0, {0}, {0}, {0}, {0}, 0},
+	{"SIM_USART1", "pty", -1, -1, 0, {0}, {0}, {0}, {0}, 0},
+	{"SIM_USART2", "stdio", -1, -1, 0, {0}, {0}, {0}, {0}, 0},
+	{"SIM_SOFTUART1", "pty", -1, -1, 0, {0}, {0}, {0}, {0}, 0},
+};
+
+
+// Frames and bytes dropped by serialWriteFrame, see serialGetStats.
+static SerialStats simDropped[SIM_NOF_PORTS];
+
+
+static int64_t simStartTimeMs = 0;
+static int64_t simTimeMs = 0;
+static int simFastClock = 0;
+
+
+static FILE *simAdcFile = NULL;
+static int64_t simAdcTimeMs = 0;
+static uint32_t adcSamples[19] = {0};
+static int adcCounter[19] = {0};
+
+
+// A very simple multimeter, it answers the commands used by scpi.c.
+static int simScpiMeter = 0;
+static int64_t simScpiMeterVoltage_mv = 230000;
+static char simScpiMeterLine[64];
+static int simScpiMeterLineLen = 0;
+
+
+
+static int64_t linuxSimWallTimeMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static void linuxSimUpdateTime()
+{
+	if (!simFastClock)
+	{
+		simTimeMs = linuxSimWallTimeMs() - simStartTimeMs;
+	}
+}
+
+int64_t systemGetSysTimeMs()
+{
+	if (simFastClock)
+	{
+		// Nothing else will advance the time, the main loop polls
+		// this until it changes.
+		simTimeMs++;
+		linuxSimPoll();
+	}
+	else
+	{
+		linuxSimUpdateTime();
+	}
+	return simTimeMs;
+}
+
+int64_t buf_time_us()
+{
+	linuxSimUpdateTime();
+	return simTimeMs * 1000;
+}
+
+void systemBusyWait(uint32_t delay)
+{
+	// Nothing to wait for in the simulation.
+}
+
+void systemSleep()
+{
+	if (simFastClock)
+	{
+		linuxSimPoll();
+	}
+	else
+	{
+		struct pollfd fds[SIM_NOF_PORTS];
+		int n = 0;
+		for(int i = 0; i < SIM_NOF_PORTS; i++)
+		{
+			if (linuxSimPorts[i].fdIn >= 0)
+			{
+				fds[n].fd = linuxSimPorts[i].fdIn;
+				fds[n].events = POLLIN;
+				fds[n].revents = 0;
+				n++;
+			}
+		}
+		// Wake up at next milli second tick or when there is input.
+		poll(fds, n, 1);
+		linuxSimPoll();
+	}
+}
+
+void systemSleepMs(int32_t timeMs)
+{
+	const int64_t endTimeMs = systemGetSysTimeMs() + timeMs;
+	while ((systemGetSysTimeMs() - endTimeMs) < 0)
+	{
+		systemSleep();
+	}
+}
+
+void systemErrorHandler(int errorCode)
+{
+	linuxSimPoll();
+	fprintf(stderr, "systemErrorHandler %d\n", errorCode);
+	exit(errorCode);
+}
+
+
+
+static void linuxSimSetRaw(int fd)
+{
+	struct termios t;
+	if (tcgetattr(fd, &t) == 0)
+	{
+		cfmakeraw(&t);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+}
+
+static int linuxSimOpenPty(LinuxSimPort *port)
+{
+	const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((fd < 0) || (grantpt(fd) != 0) || (unlockpt(fd) != 0))
+	{
+		return -1;
+	}
+	const char *name = ptsname(fd);
+
+	// Keep the slave side open, otherwise reading master gives EIO
+	// while nothing is connected.
+	const int slave = open(name, O_RDWR | O_NOCTTY);
+	if (slave < 0)
+	{
+		return -1;
+	}
+	linuxSimSetRaw(slave);
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	port->fdIn = fd;
+	port->fdOut = fd;
+	fprintf(stderr, "%s %s\n", port->envName, name);
+	return 0;
+}
+
+static int linuxSimOpenPort(LinuxSimPort *port)
+{
+	const char *connection = getenv(port->envName);
+	if (connection == NULL)
+	{
+		connection = port->defaultConnection;
+	}
+
+	if (strcmp(connection, "none") == 0)
+	{
+		return 0;
+	}
+	else if (strcmp(connection, "pty") == 0)
+	{
+		return linuxSimOpenPty(port);
+	}
+	else if (strcmp(connection, "stdio") == 0)
+	{
+		fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+		port->fdIn = STDIN_FILENO;
+		port->fdOut = STDOUT_FILENO;
+		return 0;
+	}
+	else
+	{
+		const int fd = open(connection, O_RDWR | O_NOCTTY | O_NONBLOCK);
+		if (fd < 0)
+		{
+			fprintf(stderr, "%s could not open '%s'\n", port->envName, connection);
+			return -1;
+		}
+		if (isatty(fd))
+		{
+			linuxSimSetRaw(fd);
+		}
+		port->fdIn = fd;
+		port->fdOut = fd;
+		return 0;
+	}
+}
+
+// Called by serialDmaRxUpdate.
+unsigned int serialDmaRxGetWritePos(const SerialDmaRx *serialDmaRx)
+{
+	return linuxSimPorts[serialDmaRx->usartNr].dmaRxWritePos;
+}
+
+// Simulated circular DMA, bytes are written directly into the buffer.
+// On target DMA would overwrite unread bytes if the main loop is too slow,
+// here reading stops instead so that nothing is lost.
+static void linuxSimPollDmaRx(LinuxSimPort *port)
+{
+	SerialDmaRx *dmaRx = &port->dmaRx;
+	const unsigned int writePos = port->dmaRxWritePos;
+	const unsigned int used = (writePos + dmaRx->size - dmaRx->readPos) % dmaRx->size;
+	unsigned int n = dmaRx->size - 1 - used;
+	if (n > dmaRx->size - writePos)
+	{
+		n = dmaRx->size - writePos;
+	}
+	if (n == 0)
+	{
+		return;
+	}
+	const int r = read(port->fdIn, dmaRx->buffer + writePos, n);
+	if (r > 0)
+	{
+		port->dmaRxWritePos = (writePos + r) % dmaRx->size;
+		// As the idle line or DMA half and full transfer interrupts would.
+		serialDmaRxUpdate(dmaRx);
+	}
+	else if ((r == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+	{
+		port->fdIn = -1;
+	}
+}
+
+static void linuxSimPollRx(LinuxSimPort *port)
+{
+	if (port->fdIn < 0)
+	{
+		return;
+	}
+
+	if (port->useDmaRx)
+	{
+		linuxSimPollDmaRx(port);
+		return;
+	}
+
+	char tmp[SIM_FIFO_MAX_SIZE];
+	const int n = fifo_free_space(&port->in);
+	if (n <= 0)
+	{
+		return;
+	}
+	const int r = read(port->fdIn, tmp, n);
+	if (r > 0)
+	{
+		fifoPutBlock(&port->in, tmp, r);
+	}
+	else if ((r == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+	{
+		// End of input, nothing more will come on this one.
+		port->fdIn = -1;
+	}
+}
+
+// Called by serialDmaTxKick and serialDmaTxComplete, the transfer is
+// done by linuxSimPollDmaTx.
+void serialDmaTxStart(int usartNr, const char *ptr, unsigned int len)
+{
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	port->dmaPtr = ptr;
+	port->dmaLeft = len;
+}
+
+// Simulate the DMA channel, when all bytes given to it are written
+// serialDmaTxComplete is called as the transfer complete interrupt would.
+static void linuxSimPollDmaTx(LinuxSimPort *port)
+{
+	while (port->dmaLeft > 0)
+	{
+		// Not connected, what is sent is lost.
+		const int r = (port->fdOut < 0) ? (int)port->dmaLeft : write(port->fdOut, port->dmaPtr, port->dmaLeft);
+		if (r > 0)
+		{
+			port->dmaPtr += r;
+			port->dmaLeft -= r;
+		}
+		else if ((r < 0) && (errno != EAGAIN) && (errno != EINTR))
+		{
+			// Nobody listening (EIO on pty), drop the data like a real wire would.
+			port->dmaLeft = 0;
+		}
+		else
+		{
+			return;
+		}
+
+		if (port->dmaLeft == 0)
+		{
+			serialDmaTxComplete(&port->dmaTx);
+		}
+	}
+}
+
+static void linuxSimPollTx(LinuxSimPort *port)
+{
+	if (port->useDmaTx)
+	{
+		linuxSimPollDmaTx(port);
+		return;
+	}
+
+	const int n = fifo_get_bytes_in_buffer(&port->out);
+	if (n == 0)
+	{
+		return;
+	}
+
+	if (port->fdOut < 0)
+	{
+		// Not connected, what is sent is lost.
+		fifoClear(&port->out);
+		return;
+	}
+
+	const char *ptr;
+	const int len = fifoPeekBlock(&port->out, &ptr);
+	const int r = write(port->fdOut, ptr, len);
+	if (r > 0)
+	{
+		fifoSkip(&port->out, r);
+	}
+	else if ((r < 0) && (errno != EAGAIN) && (errno != EINTR))
+	{
+		// Nobody listening (EIO on pty), drop the data like a real wire would.
+		fifoClear(&port->out);
+	}
+}
+
+static void linuxSimScpiMeterLine(const char *line)
+{
+	LinuxSimPort *port = &linuxSimPorts[DEV_SOFTUART1];
+	char reply[64];
+	reply[0] = 0;
+
+	if (strcmp(line, "FUNC?") == 0)
+	{
+		snprintf(reply, sizeof(reply), "VOLT:AC\n");
+	}
+	else if (strcmp(line, "FETC?") == 0)
+	{
+		snprintf(reply, sizeof(reply), "+%" PRId64 ".%03dE+00\n", simScpiMeterVoltage_mv / 1000, (int)(simScpiMeterVoltage_mv % 1000));
+	}
+
+	fifoPutBlock(&port->in, reply, strlen(reply));
+}
+
+static void linuxSimScpiMeterPoll()
+{
+	LinuxSimPort *port = &linuxSimPorts[DEV_SOFTUART1];
+	while (!fifoIsEmpty(&port->out))
+	{
+		const char ch = fifoTake(&port->out);
+		if ((ch == '\n') || (ch == '\r'))
+		{
+			simScpiMeterLine[simScpiMeterLineLen] = 0;
+			if (simScpiMeterLineLen > 0)
+			{
+				linuxSimScpiMeterLine(simScpiMeterLine);
+			}
+			simScpiMeterLineLen = 0;
+		}
+		else if (simScpiMeterLineLen < (int)sizeof(simScpiMeterLine) - 1)
+		{
+			simScpiMeterLine[simScpiMeterLineLen++] = ch;
+		}
+	}
+}
+
+static void linuxSimAdcPoll()
+{
+	while (simAdcTimeMs < simTimeMs)
+	{
+		simAdcTimeMs++;
+		if (simAdcFile != NULL)
+		{
+			unsigned int channel, value;
+			char line[80];
+			if (fgets(line, sizeof(line), simAdcFile) == NULL)
+			{
+				rewind(simAdcFile);
+				continue;
+			}
+			if ((sscanf(line, "%u %u", &channel, &value) == 2) && (channel < SIZEOF_ARRAY(adcSamples)))
+			{
+				adcSamples[channel] = value;
+				adcCounter[channel]++;
+			}
+		}
+		else
+		{
+			for(int i = 0; i < SIZEOF_ARRAY(adcSamples); i++)
+			{
+				adcSamples[i] = ADC_RANGE / 2;
+				adcCounter[i]++;
+			}
+		}
+	}
+}
+
+void linuxSimPoll()
+{
+	linuxSimUpdateTime();
+
+	for(int i = 0; i < SIM_NOF_PORTS; i++)
+	{
+		LinuxSimPort *port = &linuxSimPorts[i];
+		if (!port->isOpen)
+		{
+			continue;
+		}
+		if ((i == DEV_SOFTUART1) && (simScpiMeter))
+		{
+			linuxSimScpiMeterPoll();
+			continue;
+		}
+		linuxSimPollRx(port);
+		linuxSimPollTx(port);
+	}
+
+	linuxSimAdcPoll();
+}
+
+
+
+int serialInit(int usartNr, uint32_t baud)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS))
+	{
+		return -1;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	unsigned int fifoSize = FIFO_BUFFER_SIZE;
+	if (usartNr == DEV_USART1)
+	{
+		fifoSize = USART1_FIFO_SIZE;
+	}
+	else if (usartNr == DEV_USART2)
+	{
+		fifoSize = USART2_FIFO_SIZE;
+	}
+	fifoInit(&port->in, port->inBuffer, fifoSize);
+	fifoInit(&port->out, port->outBuffer, fifoSize);
+	port->isOpen = 1;
+
+	#ifdef USART1_TX_DMA
+	port->useDmaTx |= (usartNr == DEV_USART1);
+	#endif
+	#ifdef USART2_TX_DMA
+	port->useDmaTx |= (usartNr == DEV_USART2);
+	#endif
+	serialDmaTxInit(&port->dmaTx, usartNr, &port->out);
+	port->dmaLeft = 0;
+
+	#ifdef USART1_RX_DMA_SIZE
+	if (usartNr == DEV_USART1)
+	{
+		port->useDmaRx = 1;
+		serialDmaRxInit(&port->dmaRx, usartNr, port->dmaRxBuffer, USART1_RX_DMA_SIZE);
+	}
+	#endif
+	#ifdef USART2_RX_DMA_SIZE
+	if (usartNr == DEV_USART2)
+	{
+		port->useDmaRx = 1;
+		serialDmaRxInit(&port->dmaRx, usartNr, port->dmaRxBuffer, USART2_RX_DMA_SIZE);
+	}
+	#endif
+	port->dmaRxWritePos = 0;
+
+	if ((usartNr == DEV_SOFTUART1) && (simScpiMeter))
+	{
+		return 0;
+	}
+	return linuxSimOpenPort(port);
+}
+
+// On target the ISR (or DMA) would be emptying the send buffer meanwhile.
+// Here it is done when more room is needed.
+static void linuxSimMakeRoom(LinuxSimPort *port, int len)
+{
+	if (fifo_free_space(&port->out) < len)
+	{
+		if (port->useDmaTx)
+		{
+			serialDmaTxKick(&port->dmaTx);
+		}
+		linuxSimPollTx(port);
+	}
+}
+
+static void linuxSimPut(LinuxSimPort *port, int ch)
+{
+	linuxSimMakeRoom(port, 1);
+	fifoPut(&port->out, ch);
+}
+
+void serialPutChar(int usartNr, int ch)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		// Ignore this.
+		return;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	linuxSimPut(port, ch);
+	if (port->useDmaTx)
+	{
+		serialDmaTxKick(&port->dmaTx);
+	}
+}
+
+int serialGetChar(int usartNr)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return -1;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	if (port->useDmaRx)
+	{
+		char ch;
+		return (serialDmaRxRead(&port->dmaRx, &ch, 1) == 1) ? (unsigned char)ch : -1;
+	}
+	if (!fifoIsEmpty(&port->in))
+	{
+		return (unsigned char)fifoTake(&port->in);
+	}
+	return -1;
+}
+
+int serialRead(int usartNr, char *buf, int maxLen)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return 0;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	if (port->useDmaRx)
+	{
+		return serialDmaRxRead(&port->dmaRx, buf, maxLen);
+	}
+	return fifoTakeBlock(&port->in, buf, maxLen);
+}
+
+int serialPeek(int usartNr, const char **ptr)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return 0;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	if (port->useDmaRx)
+	{
+		return serialDmaRxPeek(&port->dmaRx, ptr);
+	}
+	return fifoPeekBlock(&port->in, ptr);
+}
+
+void serialSkip(int usartNr, int n)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	if (port->useDmaRx)
+	{
+		serialDmaRxSkip(&port->dmaRx, n);
+	}
+	else
+	{
+		fifoSkip(&port->in, n);
+	}
+}
+
+void serialWrite(int usartNr, const char *str, int msgLen)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return;
+	}
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	linuxSimMakeRoom(port, msgLen);
+	fifoPutBlock(&port->out, str, msgLen);
+	if (port->useDmaTx)
+	{
+		serialDmaTxKick(&port->dmaTx);
+	}
+}
+
+void serialPrint(int usartNr, const char *str)
+{
+	serialWrite(usartNr, str, strlen(str));
+}
+
+void serialPrintInt64(int usartNr, int64_t num)
+{
+	char str[64];
+	misc_lltoa(num, str, 10);
+	serialPrint(usartNr, str);
+}
+
+int serialGetFreeSpaceWriteBuffer(int usartNr)
+{
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS) || (!linuxSimPorts[usartNr].isOpen))
+	{
+		return 0;
+	}
+	return fifo_free_space(&linuxSimPorts[usartNr].out);
+}
+
+int serialTryWrite(int usartNr, const char *str, int msgLen)
+{
+	if ((usartNr >= 0) && (usartNr < SIM_NOF_PORTS))
+	{
+		linuxSimMakeRoom(&linuxSimPorts[usartNr], msgLen);
+	}
+	const int n = serialGetFreeSpaceWriteBuffer(usartNr);
+	if (msgLen > n)
+	{
+		msgLen = n;
+	}
+	serialWrite(usartNr, str, msgLen);
+	return msgLen;
+}
+
+int serialWriteFrame(int usartNr, const SerialSpan *spans, int nSpans)
+{
+	int len = 0;
+	for(int i = 0; i < nSpans; i++)
+	{
+		len += spans[i].len;
+	}
+	if ((usartNr >= 0) && (usartNr < SIM_NOF_PORTS))
+	{
+		linuxSimMakeRoom(&linuxSimPorts[usartNr], len);
+	}
+	if (len > serialGetFreeSpaceWriteBuffer(usartNr))
+	{
+		if ((usartNr >= 0) && (usartNr < SIM_NOF_PORTS))
+		{
+			simDropped[usartNr].droppedFrames++;
+			simDropped[usartNr].droppedBytes += len;
+		}
+		return -1;
+	}
+	for(int i = 0; i < nSpans; i++)
+	{
+		serialWrite(usartNr, spans[i].ptr, spans[i].len);
+	}
+	return 0;
+}
+
+void serialGetStats(int usartNr, SerialStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if ((usartNr < 0) || (usartNr >= SIM_NOF_PORTS))
+	{
+		return;
+	}
+	*stats = simDropped[usartNr];
+	LinuxSimPort *port = &linuxSimPorts[usartNr];
+	stats->txBytes = port->out.nOfBytes;
+	stats->txHighWater = port->out.highWater;
+	stats->txFullEvents = port->out.nOfFullEvents;
+	stats->droppedBytes += port->out.nOfOverflows;
+	if (port->useDmaRx)
+	{
+		stats->rxBytes = port->dmaRx.nOfBytes;
+		stats->rxHighWater = port->dmaRx.highWater;
+		stats->rxFullEvents = port->dmaRx.nOfOverruns;
+	}
+	else
+	{
+		stats->rxBytes = port->in.nOfBytes;
+		stats->rxHighWater = port->in.highWater;
+		stats->rxFullEvents = port->in.nOfFullEvents;
+	}
+}
+
+
+
+void adc1Init()
+{
+	const char *fileName = getenv("SIM_ADC_FILE");
+	if (fileName != NULL)
+	{
+		simAdcFile = fopen(fileName, "r");
+		if (simAdcFile == NULL)
+		{
+			fprintf(stderr, "SIM_ADC_FILE could not open '%s'\n", fileName);
+			systemErrorHandler(STSTEM_ADC_DRIVER_ERROR);
+		}
+	}
+	simAdcTimeMs = simTimeMs;
+}
+
+int adc1GetNOfSamples(uint32_t channel)
+{
+	SYSTEM_ASSERT(channel < SIZEOF_ARRAY(adcCounter));
+	return adcCounter[channel];
+}
+
+uint32_t adc1GetSample(uint32_t channel)
+{
+	SYSTEM_ASSERT(channel < SIZEOF_ARRAY(adcSamples));
+	return adcSamples[channel];
+}
+
+
+
+// Called by main_loop once the serial ports are up.
+void linux_sim_init()
+{
+	fflush(stdout);
+}
+
+// Called by main_loop before the application modules are initiated.
+void simulated_init()
+{
+	linuxSimPoll();
+}
+
+// Since serial ports are opened by main_loop the simulation settings
+// must be read before that, this is called before main.
+static void __attribute__ ((constructor)) linuxSimConstructor()
+{
+	simStartTimeMs = linuxSimWallTimeMs();
+	simFastClock = (getenv("SIM_FAST_CLOCK") != NULL);
+
+	const char *meter = getenv("SIM_SCPI_METER");
+	if (meter != NULL)
+	{
+		simScpiMeter = 1;
+		simScpiMeterVoltage_mv = (int64_t)(atof(meter) * 1000.0);
+	}
+}
+
+#endif
+
+#if (defined USART1_RX_DMA_SIZE) && (USART1_RX_DMA_SIZE > SIM_DMA_RX_MAX_SIZE)
+#error
+#endif
+#if (defined USART2_RX_DMA_SIZE) && (USART2_RX_DMA_SIZE > SIM_DMA_RX_MAX_SIZE)
+#error
+#endif
+#if (USART1_FIFO_SIZE > SIM_FIFO_MAX_SIZE) || (USART2_FIFO_SIZE > SIM_FIFO_MAX_SIZE)
+#error
+#endif
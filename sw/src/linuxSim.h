@@ -0,0 +1,57 @@
+/*
+linuxSim.h
+
+Run the firmware as a process on a linux PC. This replaces systemInit.c,
+serialDev.c, adcDev.c and SoftUart.c when building with "make host".
+
+*/
+
+#ifndef LINUXSIM_H
+#define LINUXSIM_H
+
+#include <stdint.h>
+
+#if (defined __linux__)
+
+/*
+The simulation is configured using environment variables:
+
+SIM_USART1, SIM_USART2, SIM_SOFTUART1
+  What the serial port shall be connected to.
+  "pty"     a pseudo terminal is opened, its name is printed on stderr.
+  "stdio"   stdin/stdout.
+  "none"    nothing, output is discarded.
+  Otherwise it is taken as the name of a file, fifo or tty to open.
+  Default is "pty" for USART1 and SOFTUART1 and "stdio" for USART2
+  (USART2 is the debug port, see DEBUG_DEV in cfg.h).
+
+SIM_FAST_CLOCK
+  If set the simulated milli second clock is advanced one tick every
+  time it is read instead of following wall time. The simulation then
+  runs as fast as the PC allows.
+
+SIM_ADC_FILE
+  A text file with one ADC sample per line "<channel> <value>". One line
+  is consumed per simulated milli second, the file is restarted at end.
+  Without this all channels read half ADC_RANGE.
+
+SIM_SCPI_METER
+  If set a simple SCPI multimeter is simulated on SOFTUART1 instead of
+  connecting the port to something external. The value is the AC voltage
+  it shall report, in volts.
+
+Flash (eeprom) is stored in files eeprom0.bin and eeprom1.bin in the
+current directory, see flash.c.
+*/
+
+// These are called by main_loop.
+void linux_sim_init();
+void simulated_init();
+
+// Move data between the simulated serial ports and the outside world.
+// Called from systemSleep, but can be called more often if needed.
+void linuxSimPoll();
+
+#endif
+
+#endif
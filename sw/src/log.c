@@ -20,6 +20,7 @@ All rights reserved etc etc...
 #include "mathi.h"
 #include "debugLog.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 
 int32_t logSequenceNumber=0;
 
@@ -138,10 +139,11 @@ static int64_t loggedParameterTime[LOGGING_MAX_NOF_PARAMETERS];
 
 static void sendParameterStatus(PARAMETER_CODES par, int64_t value)
 {
-	secAndLogInitStatusMessageAddHeader(&statusDbfMessage, PARAMETER_STATUS_MSG);
-	DbfSerializerWriteInt32(&statusDbfMessage, par);
-	DbfSerializerWriteInt64(&statusDbfMessage, value);
-	messageSendDbf(&statusDbfMessage);
+	char buf[48];
+	DbfSerializer dbfSerializer;
+	DbfSerializerInitBuffer(&dbfSerializer, buf, sizeof(buf));
+	statusMsgEncodeParameter(&dbfSerializer, par, value);
+	messageSendDbf(&dbfSerializer);
 }
 
 static void logParameter(PARAMETER_CODES par, int64_t value, int time_ms)
@@ -21,10 +21,9 @@ Henrik Bjorkman
 #include "machineState.h"
 #include "debugLog.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 #include "serialDev.h"
 
-DbfSerializer statusDbfMessage;
-
 int errorReported = portsErrorOk; // REPORTED_ERROR_PAR
 //int startCmd=cmdPauseCommand;
 
@@ -54,10 +53,7 @@ Extract from msg.c (if changed msg.c has precedence):
 */
 static void sendLogAssertError(const char *msg, const char* file, int32_t line)
 {
-	logInitAndAddHeader(&messageDbfTmpBuffer, ERROR_ASSERT);
-	DbfSerializerWriteString(&messageDbfTmpBuffer, msg);
-	DbfSerializerWriteString(&messageDbfTmpBuffer, file);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, line);
+	logMsgEncodeErrorAssert(&messageDbfTmpBuffer, msg, file, line);
 	messageSendDbf(&messageDbfTmpBuffer);
 }
 
@@ -77,8 +73,7 @@ This is an extract from msg.c (things might change, that file has precedence if
 */
 void secAndLogInitStatusMessageAddHeader(DbfSerializer *dbfMessage, STATUS_MESSAGES msg)
 {
-	messageInitAndAddCategoryAndSender(dbfMessage, STATUS_CATEGORY);
-	DbfSerializerWriteInt32(dbfMessage, msg);
+	messageInitAndAddStatusHeader(dbfMessage, msg);
 }
 
 void errorReportError(int errorCode)
@@ -27,7 +27,6 @@ extern int64_t cyclesToDo; // TODO remove this extern declaration, use get/set C
 extern int64_t totalCyclesPerformed;
 extern uint32_t machineSessionNumber;
 
-extern DbfSerializer statusDbfMessage;
 extern int32_t maxAllowedCurrent_mA;
 extern int32_t maxAllowedExternalVoltage_mV;
 
@@ -20,11 +20,11 @@ Henrik Bjorkman
 #include <stdio.h>
 #include <unistd.h>
 #elif (defined __arm__)
-#include "systemInit.h"
 #include "timerDev.h"
 #else
 #error
 #endif
+#include "systemInit.h"
 
 #include "mathi.h"
 #include "machineState.h"
@@ -162,6 +162,9 @@ void secAndLogMediumTick(void)
 		}
 		case 5:
 		{
+			#ifdef SERIAL_STATS_INTERVAL_S
+			cmdSecondsTick();
+			#endif
 			superviceState++;
 			break;
 		}
@@ -22,10 +22,14 @@ Henrik
 #include <string.h>
 #include <ctype.h>
 
+#if (defined __arm__)
 #include "stm32l4xx.h"
 #include "stm32l432xx.h"
 #include "stm32l4xx_nucleo_32.h"
 #include "stm32l4xx_ll_adc.h"
+#elif (defined __linux__)
+#include "linuxSim.h"
+#endif
 
 #include "systemInit.h"
 #include "timerDev.h"
@@ -46,6 +50,7 @@ Henrik
 #include "debugLog.h"
 #include "serialDev.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 
 
 
@@ -227,7 +232,7 @@ int main_loop(void)
 	wdt_reset();
 
 	// Tell web server that we rebooted. It shall clear some stored values.
-	secAndLogInitStatusMessageAddHeader(&messageDbfTmpBuffer, REBOOT_STATUS_MSG);
+	statusMsgEncodeReboot(&messageDbfTmpBuffer);
 	messageSendDbf(&messageDbfTmpBuffer);
 
 	mainLog(LOG_PREFIX "Enter main loop" LOG_SUFIX);
@@ -301,6 +306,9 @@ int main_loop(void)
 		}
 		case 6:
 		{
+			#ifdef STATUS_BATCH_MS
+			messageBatchMediumTick();
+			#endif
 			tickState++;
 			break;
 		}
@@ -95,12 +95,8 @@ Message format
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
-#if (defined __linux__) || (defined __WIN32)
-#include "log.h"
-#else
 #include "Dbf.h"
 #include "eeprom.h"
-#endif
 #include "messageNames.h"
 
 
@@ -142,6 +138,9 @@ const char *getStatusMessagesName(STATUS_MESSAGES statusCode)
 		case VOLTAGE_STATUS_MSG: return "VOLTAGE_STATUS";
 		case PARAMETER_STATUS_MSG: return "PARAMETER_STATUS";
 		case TEMP_STATUS_MSG: return "TEMP_STATUS_MSG";
+		case BATCH_STATUS_MSG: return "BATCH_STATUS";
+		case DELTA_STATUS_MSG: return "DELTA_STATUS";
+		case SERIAL_STATS_STATUS_MSG: return "SERIAL_STATS";
 		//case WEB_SERVER_STATUS_MSG: return "WEB_SERVER_STATUS_MSG";
 		#endif
 		default: break;
@@ -219,7 +218,6 @@ const char * getParameterName(PARAMETER_CODES parameterCode)
 		case TEMP1_C: return "TEMP1_C";
 		case TEMP2_C: return "TEMP2_C";
 		case REPORTED_ERROR: return "REPORTED_ERROR";
-		case SCAN_DELAY_MS: return "SCAN_DELAY_MS";
 		case SYS_TIME_MS: return "SYS_TIME_MS";
 		#endif
 		default: break;
@@ -53,6 +53,9 @@ typedef enum
 	LEAK_CURRENT_STATUS_MSG = 5,
 	PARAMETER_STATUS_MSG = 10,
 	TEMP_STATUS_MSG = 11,
+	BATCH_STATUS_MSG = 12,          // Several readings in one message, see messageBatchAdd.
+	DELTA_STATUS_MSG = 13,          // Difference from previous status message, see messageDeltaBegin.
+	SERIAL_STATS_STATUS_MSG = 14,   // Counters of a serial port, see SerialStats.
 } STATUS_MESSAGES;
 
 // Codes used in COMMAND_CATEGORY messages.
@@ -94,6 +97,10 @@ enum
 	portsErrorAssert=23,
 } PORTS_ERROR_CODES;
 
+// Number of codes reserved per serial parameter, one per serial port,
+// see SERIAL_RX_BYTES. Changing it changes the codes of those parameters.
+#define SERIAL_STATS_NOF_PORTS 4
+
 // All parameters who's name ends with a number must be listed here in sequence.
 // Is is for example assumed in other parts of SW that TARGET_CYCLES_x &
 // REACHED_CYCLES_x are in sequence. So, things need to stay that way.
@@ -116,6 +123,24 @@ typedef enum
 	par_version_minor = 111,
 	par_version_debug = 112,
 	par_magicNumber = 113,
+	// Serial port counters, see SerialStats. One per port (DEV_LPUART1,
+	// DEV_USART1 and so on) so for example SERIAL_RX_BYTES + DEV_USART1.
+	// SERIAL_STATS_NOF_PORTS must be same as SERIAL_NOF_DEV in serialDev.h.
+	// These change all the time so they are not included in
+	// LOGGING_MAX_NOF_PARAMETERS, they are sent in SERIAL_STATS_STATUS_MSG.
+	SERIAL_RX_BYTES = 120,
+	SERIAL_TX_BYTES = SERIAL_RX_BYTES + SERIAL_STATS_NOF_PORTS,
+	SERIAL_ISR_ENTRIES = SERIAL_TX_BYTES + SERIAL_STATS_NOF_PORTS,
+	SERIAL_OVERRUN_ERRORS = SERIAL_ISR_ENTRIES + SERIAL_STATS_NOF_PORTS,
+	SERIAL_FRAMING_ERRORS = SERIAL_OVERRUN_ERRORS + SERIAL_STATS_NOF_PORTS,
+	SERIAL_NOISE_ERRORS = SERIAL_FRAMING_ERRORS + SERIAL_STATS_NOF_PORTS,
+	SERIAL_RX_HIGH_WATER = SERIAL_NOISE_ERRORS + SERIAL_STATS_NOF_PORTS,
+	SERIAL_TX_HIGH_WATER = SERIAL_RX_HIGH_WATER + SERIAL_STATS_NOF_PORTS,
+	SERIAL_RX_FULL_EVENTS = SERIAL_TX_HIGH_WATER + SERIAL_STATS_NOF_PORTS,
+	SERIAL_TX_FULL_EVENTS = SERIAL_RX_FULL_EVENTS + SERIAL_STATS_NOF_PORTS,
+	SERIAL_DROPPED_FRAMES = SERIAL_TX_FULL_EVENTS + SERIAL_STATS_NOF_PORTS,
+	SERIAL_DROPPED_BYTES = SERIAL_DROPPED_FRAMES + SERIAL_STATS_NOF_PORTS,
+	SERIAL_STATS_END = SERIAL_DROPPED_BYTES + SERIAL_STATS_NOF_PORTS,
 	// Remember to update LOGGING_MAX_NOF_PARAMETERS if a parameter is added here.
 } PARAMETER_CODES;
 
@@ -0,0 +1,210 @@
+/*
+messageSchema.c
+
+Decoding of messages to text, generated from the tables in messageSchema.h.
+
+*/
+
+#include <stddef.h>
+#include "cfg.h"
+#include "miscUtilities.h"
+#include "Dbf.h"
+#include "messageUtilities.h"
+#include "messageSchema.h"
+
+
+#ifdef STATUS_DELTA_KEYFRAME
+// Values in the latest status message sent, see MSG_SCHEMA_STATUS_SEND_DELTA.
+#define MSG_SCHEMA_STATUS_PREVIOUS_DEFINE(code, name, fields, delta, batch) name##StatusPrevious statusMsgPrevious##name;
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_PREVIOUS_DEFINE)
+
+#define MSG_SCHEMA_STATUS_FORCE_KEYFRAME(code, name, fields, delta, batch) statusMsgPrevious##name.nOfDeltas = 0;
+void statusMsgForceKeyframes()
+{
+	STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_FORCE_KEYFRAME)
+}
+#endif
+
+
+#if (defined __linux__) || (defined __WIN32) || (defined DEBUG_DECODE_DBF)
+
+// How many senders to remember status values from, for delta messages.
+#define MSG_SCHEMA_N_OF_SENDERS 8
+
+static int fieldNameToString(const char *separator, const char *name, char *bufPtr, int bufSize)
+{
+	int c = 0;
+	c += utility_strccpy(bufPtr+c, separator, bufSize-c);
+	c += utility_strccpy(bufPtr+c, name, bufSize-c);
+	c += utility_strccpy(bufPtr+c, "=", bufSize-c);
+	return c;
+}
+
+static int fieldIntToString(const char *separator, const char *name, int64_t value, char *bufPtr, int bufSize)
+{
+	int c = fieldNameToString(separator, name, bufPtr, bufSize);
+	c += utility_lltoa(value, bufPtr+c, 10, bufSize-c);
+	return c;
+}
+
+static int fieldDecimalToString(const char *separator, const char *name, int64_t mantissa, int32_t exponent, char *bufPtr, int bufSize)
+{
+	int c = fieldNameToString(separator, name, bufPtr, bufSize);
+	c += decimalToString(mantissa, exponent, bufPtr+c, bufSize-c);
+	return c;
+}
+
+static int fieldStringToString(const char *separator, const char *name, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
+{
+	int c = fieldNameToString(separator, name, bufPtr, bufSize);
+	c += utility_strccpy(bufPtr+c, "\"", bufSize-c);
+	c += DbfUnserializerReadString(dbfUnserializer, bufPtr+c, bufSize-c);
+	c += utility_strccpy(bufPtr+c, "\"", bufSize-c);
+	return c;
+}
+
+
+#define MSG_SCHEMA_TO_STRING_INT32(name) c += fieldIntToString(separator, #name, DbfUnserializerReadInt32(dbfUnserializer), bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_TO_STRING_INT64(name) c += fieldIntToString(separator, #name, DbfUnserializerReadInt64(dbfUnserializer), bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_TO_STRING_TIME(name) MSG_SCHEMA_TO_STRING_INT64(name)
+#define MSG_SCHEMA_TO_STRING_DECIMAL(name) \
+	{ \
+		int64_t mantissa = 0; \
+		int32_t exponent = 0; \
+		DbfUnserializerReadDecimal(dbfUnserializer, &mantissa, &exponent); \
+		c += fieldDecimalToString(separator, #name, mantissa, exponent, bufPtr+c, bufSize-c); \
+	}
+#define MSG_SCHEMA_TO_STRING_STRING(name) c += fieldStringToString(separator, #name, dbfUnserializer, bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_TO_STRING(type, name) MSG_SCHEMA_TO_STRING_##type(name) separator = " ";
+
+#define MSG_SCHEMA_CASE_TO_STRING(code, name, fields) \
+	case code: \
+	{ \
+		fields(MSG_SCHEMA_TO_STRING) \
+		break; \
+	}
+
+#define MSG_SCHEMA_FIELDS_TO_STRING(functionName, table) \
+int functionName(int code, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize) \
+{ \
+	int c = 0; \
+	const char *separator = ""; \
+	(void)separator; \
+	if ((bufPtr == NULL) || (bufSize<=0) || (bufSize >= 0x70000000)) \
+	{ \
+		return c; \
+	} \
+	*bufPtr = 0; \
+	switch(code) \
+	{ \
+		table(MSG_SCHEMA_CASE_TO_STRING) \
+		default: return -1; \
+	} \
+	return c; \
+}
+
+MSG_SCHEMA_FIELDS_TO_STRING(logMsgFieldsToString, LOG_MESSAGE_TABLE)
+MSG_SCHEMA_FIELDS_TO_STRING(commandMsgFieldsToString, COMMAND_MESSAGE_TABLE)
+
+
+// Status messages are read into a struct so that values can be remembered
+// for the delta messages (DELTA_STATUS_MSG) that follow.
+
+#define MSG_SCHEMA_KEY_READ_INT32(name) msg->name = DbfUnserializerReadInt32(dbfUnserializer);
+#define MSG_SCHEMA_KEY_READ_INT64(name) msg->name = DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_KEY_READ_TIME(name) msg->name = timeBase + DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_KEY_READ_DECIMAL(name) DbfUnserializerReadDecimal(dbfUnserializer, &msg->name##_m, &msg->name##_e);
+#define MSG_SCHEMA_KEY_READ_STRING(name) DbfUnserializerReadString(dbfUnserializer, msg->name, sizeof(msg->name));
+#define MSG_SCHEMA_KEY_READ(type, name) MSG_SCHEMA_KEY_READ_##type(name)
+
+#define MSG_SCHEMA_DELTA_READ_INT32(name) msg->name += DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_DELTA_READ_INT64(name) msg->name += DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_DELTA_READ_TIME(name) msg->name += DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_DELTA_READ_DECIMAL(name) \
+	if (DbfUnserializerReadIsNextDecimal(dbfUnserializer)) \
+	{ \
+		DbfUnserializerReadDecimal(dbfUnserializer, &msg->name##_m, &msg->name##_e); \
+	} \
+	else \
+	{ \
+		msg->name##_m += DbfUnserializerReadInt64(dbfUnserializer); \
+	}
+#define MSG_SCHEMA_DELTA_READ_STRING(name) DbfUnserializerReadString(dbfUnserializer, msg->name, sizeof(msg->name));
+#define MSG_SCHEMA_DELTA_READ(type, name) MSG_SCHEMA_DELTA_READ_##type(name)
+
+#define MSG_SCHEMA_PRINT_INT32(name) c += fieldIntToString(separator, #name, msg->name, bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_PRINT_INT64(name) c += fieldIntToString(separator, #name, msg->name, bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_PRINT_TIME(name) c += fieldIntToString(separator, #name, msg->name, bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_PRINT_DECIMAL(name) c += fieldDecimalToString(separator, #name, msg->name##_m, msg->name##_e, bufPtr+c, bufSize-c);
+#define MSG_SCHEMA_PRINT_STRING(name) \
+	c += fieldNameToString(separator, #name, bufPtr+c, bufSize-c); \
+	c += utility_strccpy(bufPtr+c, "\"", bufSize-c); \
+	c += utility_strccpy(bufPtr+c, msg->name, bufSize-c); \
+	c += utility_strccpy(bufPtr+c, "\"", bufSize-c);
+#define MSG_SCHEMA_PRINT(type, name) MSG_SCHEMA_PRINT_##type(name) separator = " ";
+
+#define MSG_SCHEMA_STATUS_TO_STRING(code, name, fields, delta, batch) \
+static name##StatusMsg statusMsgReceived##name[MSG_SCHEMA_N_OF_SENDERS]; \
+static uint8_t statusMsgReceivedValid##name[MSG_SCHEMA_N_OF_SENDERS]; \
+static unsigned int statusMsgReceivedNext##name = 0; \
+\
+static int statusMsgToString##name(int64_t senderId, int64_t timeBase, int isDelta, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize) \
+{ \
+	int c = 0; \
+	const char *separator = ""; \
+	(void)separator; \
+	name##StatusMsg noKeyframe = {0}; \
+	name##StatusMsg *msg = NULL; \
+	for(int i = 0; i < MSG_SCHEMA_N_OF_SENDERS; i++) \
+	{ \
+		if (statusMsgReceivedValid##name[i] && (statusMsgReceived##name[i].senderId == senderId)) \
+		{ \
+			msg = &statusMsgReceived##name[i]; \
+		} \
+	} \
+	if (isDelta) \
+	{ \
+		if (msg == NULL) \
+		{ \
+			c += utility_strccpy(bufPtr+c, "(no keyframe) ", bufSize-c); \
+			msg = &noKeyframe; \
+		} \
+		fields(MSG_SCHEMA_DELTA_READ) \
+	} \
+	else \
+	{ \
+		if (msg == NULL) \
+		{ \
+			const unsigned int i = statusMsgReceivedNext##name; \
+			statusMsgReceivedNext##name = (i + 1) % MSG_SCHEMA_N_OF_SENDERS; \
+			statusMsgReceivedValid##name[i] = 1; \
+			msg = &statusMsgReceived##name[i]; \
+			msg->senderId = senderId; \
+		} \
+		fields(MSG_SCHEMA_KEY_READ) \
+	} \
+	fields(MSG_SCHEMA_PRINT) \
+	return c; \
+}
+
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_TO_STRING)
+
+#define MSG_SCHEMA_STATUS_CASE_TO_STRING(code, name, fields, delta, batch) \
+	case code: return statusMsgToString##name(senderId, timeBase, isDelta, dbfUnserializer, bufPtr, bufSize);
+
+int statusMsgFieldsToString(int code, int64_t senderId, int64_t timeBase, int isDelta, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
+{
+	if ((bufPtr == NULL) || (bufSize<=0) || (bufSize >= 0x70000000))
+	{
+		return 0;
+	}
+	*bufPtr = 0;
+	switch(code)
+	{
+		STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_CASE_TO_STRING)
+		default: break;
+	}
+	return -1;
+}
+
+#endif
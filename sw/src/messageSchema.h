@@ -0,0 +1,450 @@
+/*
+messageSchema.h
+
+The fields of the status, log and command messages, in one table.
+
+Encode and decode functions (and the host side decoders to text in
+messageSchema.c) are generated from the tables below so that sender and
+receiver can not get out of sync. To add a message add a line to one of the
+tables and a FIELDS macro for it.
+
+*/
+
+#ifndef MESSAGE_SCHEMA_H
+#define MESSAGE_SCHEMA_H
+
+#include <stdint.h>
+#include "cfg.h"
+#include "Dbf.h"
+#include "messageNames.h"
+#include "messageUtilities.h"
+#include "log.h"
+
+
+/*
+Field types, each field is given as F(<type>, <name>).
+  INT32, INT64  An integer.
+  TIME          Time in milli seconds, see systemGetSysTimeMs. An INT64 but
+                in a BATCH_STATUS_MSG it is given relative the batch time.
+  DECIMAL       A decimal number, mantissa * 10^exponent. Given as two
+                parameters <name>_m and <name>_e, see DbfSerializerWriteDecimal.
+  STRING        A text string.
+*/
+
+// Max size of a string field in the decoded structs, including terminator.
+#define MSG_SCHEMA_STRING_SIZE 64
+
+
+/*
+STATUS_CATEGORY messages, the header is:
+  <sender ID>
+  <status message type>
+*/
+#define STATUS_REBOOT_FIELDS(F)
+
+#define STATUS_VOLTAGE_FIELDS(F) \
+	F(TIME, timeMs) \
+	F(DECIMAL, voltage) \
+	F(INT32, frequency)
+
+#define STATUS_LEAK_CURRENT_FIELDS(F) \
+	F(TIME, timeMs) \
+	F(INT32, current_mA)
+
+#define STATUS_PARAMETER_FIELDS(F) \
+	F(INT32, parameter) \
+	F(INT64, value)
+
+#ifdef TEMP_INTERNAL_ADC_CHANNEL
+#define STATUS_TEMP_FIELDS(F) \
+	F(TIME, timeMs) \
+	F(INT32, temp1_C) \
+	F(INT32, temp2_C) \
+	F(INT32, tempInternal_C)
+#else
+#define STATUS_TEMP_FIELDS(F) \
+	F(TIME, timeMs) \
+	F(INT32, temp1_C) \
+	F(INT32, temp2_C)
+#endif
+
+#define STATUS_SERIAL_STATS_FIELDS(F) \
+	F(INT32, port) \
+	F(INT64, rxBytes) \
+	F(INT64, txBytes) \
+	F(INT64, isrEntries) \
+	F(INT64, overrunErrors) \
+	F(INT64, framingErrors) \
+	F(INT64, noiseErrors) \
+	F(INT32, rxHighWater) \
+	F(INT32, txHighWater) \
+	F(INT64, rxFullEvents) \
+	F(INT64, txFullEvents) \
+	F(INT64, droppedFrames) \
+	F(INT64, droppedBytes)
+
+// M(<message type code>, <name>, <fields>, <delta>, <batch>)
+// If delta is 1 the message may be sent as a DELTA_STATUS_MSG, see STATUS_DELTA_KEYFRAME.
+// If batch is 1 the message is sent in a BATCH_STATUS_MSG, see STATUS_BATCH_MS.
+#define STATUS_MESSAGE_TABLE(M) \
+	M(REBOOT_STATUS_MSG, Reboot, STATUS_REBOOT_FIELDS, 0, 0) \
+	M(VOLTAGE_STATUS_MSG, Voltage, STATUS_VOLTAGE_FIELDS, 1, 1) \
+	M(LEAK_CURRENT_STATUS_MSG, LeakCurrent, STATUS_LEAK_CURRENT_FIELDS, 1, 1) \
+	M(PARAMETER_STATUS_MSG, Parameter, STATUS_PARAMETER_FIELDS, 0, 0) \
+	M(TEMP_STATUS_MSG, Temp, STATUS_TEMP_FIELDS, 1, 1) \
+	M(SERIAL_STATS_STATUS_MSG, SerialStats, STATUS_SERIAL_STATS_FIELDS, 0, 0)
+
+
+/*
+LOG_CATEGORY messages, the header is:
+  <sender ID>
+  <log sequence number>
+  <log message type>
+Most log messages are just a list of integers (see logInt in log.c),
+only those with other fields are listed here.
+*/
+#define LOG_ERROR_ASSERT_FIELDS(F) \
+	F(STRING, msg) \
+	F(STRING, file) \
+	F(INT32, line)
+
+#define LOG_MESSAGE_TABLE(M) \
+	M(ERROR_ASSERT, ErrorAssert, LOG_ERROR_ASSERT_FIELDS)
+
+
+/*
+COMMAND_CATEGORY messages, the header is:
+  <sender ID>
+  <destination ID>, -1 for all.
+  <reference number>
+  <command code>
+*/
+#define COMMAND_GET_FIELDS(F) \
+	F(INT32, parameter)
+
+#define COMMAND_SET_FIELDS(F) \
+	F(INT32, parameter) \
+	F(INT64, value)
+
+#define COMMAND_MESSAGE_TABLE(M) \
+	M(GET_CMD, Get, COMMAND_GET_FIELDS) \
+	M(SET_CMD, Set, COMMAND_SET_FIELDS)
+
+
+
+// Below is the code generated from the tables.
+
+// A function parameter per field.
+#define MSG_SCHEMA_PARAM_INT32(name) , int32_t name
+#define MSG_SCHEMA_PARAM_INT64(name) , int64_t name
+#define MSG_SCHEMA_PARAM_TIME(name) , int64_t name
+#define MSG_SCHEMA_PARAM_DECIMAL(name) , int64_t name##_m, int32_t name##_e
+#define MSG_SCHEMA_PARAM_STRING(name) , const char *name
+#define MSG_SCHEMA_PARAM(type, name) MSG_SCHEMA_PARAM_##type(name)
+
+// Passing the parameters on.
+#define MSG_SCHEMA_ARG_INT32(name) , name
+#define MSG_SCHEMA_ARG_INT64(name) , name
+#define MSG_SCHEMA_ARG_TIME(name) , name
+#define MSG_SCHEMA_ARG_DECIMAL(name) , name##_m, name##_e
+#define MSG_SCHEMA_ARG_STRING(name) , name
+#define MSG_SCHEMA_ARG(type, name) MSG_SCHEMA_ARG_##type(name)
+
+// A struct member per field.
+#define MSG_SCHEMA_MEMBER_INT32(name) int32_t name;
+#define MSG_SCHEMA_MEMBER_INT64(name) int64_t name;
+#define MSG_SCHEMA_MEMBER_TIME(name) int64_t name;
+#define MSG_SCHEMA_MEMBER_DECIMAL(name) int64_t name##_m; int32_t name##_e;
+#define MSG_SCHEMA_MEMBER_STRING(name) char name[MSG_SCHEMA_STRING_SIZE];
+#define MSG_SCHEMA_MEMBER(type, name) MSG_SCHEMA_MEMBER_##type(name)
+
+// Serializing a field.
+#define MSG_SCHEMA_WRITE_INT32(name) DbfSerializerWriteInt32(dbfSerializer, name);
+#define MSG_SCHEMA_WRITE_INT64(name) DbfSerializerWriteInt64(dbfSerializer, name);
+#define MSG_SCHEMA_WRITE_TIME(name) DbfSerializerWriteInt64(dbfSerializer, name);
+#define MSG_SCHEMA_WRITE_DECIMAL(name) DbfSerializerWriteDecimal(dbfSerializer, name##_m, name##_e);
+#define MSG_SCHEMA_WRITE_STRING(name) DbfSerializerWriteString(dbfSerializer, name);
+#define MSG_SCHEMA_WRITE(type, name) MSG_SCHEMA_WRITE_##type(name)
+
+// Same as above but for a reading in a BATCH_STATUS_MSG.
+#define MSG_SCHEMA_BATCH_WRITE_INT32(name) MSG_SCHEMA_WRITE_INT32(name)
+#define MSG_SCHEMA_BATCH_WRITE_INT64(name) MSG_SCHEMA_WRITE_INT64(name)
+#define MSG_SCHEMA_BATCH_WRITE_TIME(name) DbfSerializerWriteInt64(dbfSerializer, name - messageBatchGetTimeMs());
+#define MSG_SCHEMA_BATCH_WRITE_DECIMAL(name) MSG_SCHEMA_WRITE_DECIMAL(name)
+#define MSG_SCHEMA_BATCH_WRITE_STRING(name) MSG_SCHEMA_WRITE_STRING(name)
+#define MSG_SCHEMA_BATCH_WRITE(type, name) MSG_SCHEMA_BATCH_WRITE_##type(name)
+
+// For a reading in a DELTA_STATUS_MSG, the difference from previous is
+// written. Decimals are written as a mantissa difference if exponent is
+// same as previous, otherwise as a decimal. Strings are always written.
+#define MSG_SCHEMA_DELTA_WRITE_INT32(name) DbfSerializerWriteInt64(dbfSerializer, (int64_t)name - previous->msg.name);
+#define MSG_SCHEMA_DELTA_WRITE_INT64(name) DbfSerializerWriteInt64(dbfSerializer, name - previous->msg.name);
+#define MSG_SCHEMA_DELTA_WRITE_TIME(name) DbfSerializerWriteInt64(dbfSerializer, name - previous->msg.name);
+#define MSG_SCHEMA_DELTA_WRITE_DECIMAL(name) \
+	if (name##_e == previous->msg.name##_e) \
+	{ \
+		DbfSerializerWriteInt64(dbfSerializer, name##_m - previous->msg.name##_m); \
+	} \
+	else \
+	{ \
+		DbfSerializerWriteDecimal(dbfSerializer, name##_m, name##_e); \
+	}
+#define MSG_SCHEMA_DELTA_WRITE_STRING(name) DbfSerializerWriteString(dbfSerializer, name);
+#define MSG_SCHEMA_DELTA_WRITE(type, name) MSG_SCHEMA_DELTA_WRITE_##type(name)
+
+// Remember the values sent, for next delta.
+#define MSG_SCHEMA_SAVE_INT32(name) previous->msg.name = name;
+#define MSG_SCHEMA_SAVE_INT64(name) previous->msg.name = name;
+#define MSG_SCHEMA_SAVE_TIME(name) previous->msg.name = name;
+#define MSG_SCHEMA_SAVE_DECIMAL(name) previous->msg.name##_m = name##_m; previous->msg.name##_e = name##_e;
+#define MSG_SCHEMA_SAVE_STRING(name)
+#define MSG_SCHEMA_SAVE(type, name) MSG_SCHEMA_SAVE_##type(name)
+
+// Decimals as the receiver will see them, so that exponents compare correctly.
+#define MSG_SCHEMA_NORMALIZE_INT32(name)
+#define MSG_SCHEMA_NORMALIZE_INT64(name)
+#define MSG_SCHEMA_NORMALIZE_TIME(name)
+#define MSG_SCHEMA_NORMALIZE_DECIMAL(name) DbfDecimalNormalize(&name##_m, &name##_e);
+#define MSG_SCHEMA_NORMALIZE_STRING(name)
+#define MSG_SCHEMA_NORMALIZE(type, name) MSG_SCHEMA_NORMALIZE_##type(name)
+
+// Unserializing a field into the struct. The decode function returns -1 if
+// next code is not of the field's type, that is also the case if the
+// message has ended (it was truncated).
+#define MSG_SCHEMA_READ_INT32(name) if (!DbfUnserializerReadIsNextInt(dbfUnserializer)) {return -1;} msg->name = DbfUnserializerReadInt32(dbfUnserializer);
+#define MSG_SCHEMA_READ_INT64(name) if (!DbfUnserializerReadIsNextInt(dbfUnserializer)) {return -1;} msg->name = DbfUnserializerReadInt64(dbfUnserializer);
+#define MSG_SCHEMA_READ_TIME(name) MSG_SCHEMA_READ_INT64(name)
+#define MSG_SCHEMA_READ_DECIMAL(name) if (DbfUnserializerReadDecimal(dbfUnserializer, &msg->name##_m, &msg->name##_e) != 0) {return -1;}
+#define MSG_SCHEMA_READ_STRING(name) if (!DbfUnserializerReadIsNextString(dbfUnserializer)) {return -1;} DbfUnserializerReadString(dbfUnserializer, msg->name, sizeof(msg->name));
+#define MSG_SCHEMA_READ(type, name) MSG_SCHEMA_READ_##type(name)
+
+// Same for the integers of the header, that must have the given value.
+#define MSG_SCHEMA_READ_EXPECT(value) if (!DbfUnserializerReadIsNextInt(dbfUnserializer) || (DbfUnserializerReadInt32(dbfUnserializer) != (value))) {return -1;}
+
+
+/*
+For each status message this gives (using Voltage as example):
+  VoltageStatusMsg
+    Struct with sender ID and the fields.
+  statusMsgEncodeVoltage(dbfSerializer, timeMs, voltage_m, voltage_e, frequency)
+    Init dbfSerializer and write the complete message, except CRC.
+  statusMsgDecodeVoltage(dbfUnserializer, msg)
+    Read a complete message. Returns 0 if OK.
+  statusMsgSendVoltage(dbfSerializer, timeMs, voltage_m, voltage_e, frequency)
+    Encode and send the message using dbfSerializer. If STATUS_BATCH_MS is
+    defined (and batch is 1 in the table) the reading is instead added to
+    the batch, see messageBatchAdd.
+    If STATUS_DELTA_KEYFRAME is defined only every STATUS_DELTA_KEYFRAME:th
+    message is sent in full, the others as differences, see DELTA_STATUS_MSG.
+    A difference is only remembered as sent if the message was queued, a
+    dropped keyframe is sent again next time.
+*/
+#define MSG_SCHEMA_STATUS_STRUCT(code, name, fields, delta, batch) \
+typedef struct \
+{ \
+	int64_t senderId; \
+	fields(MSG_SCHEMA_MEMBER) \
+} name##StatusMsg;
+
+#define MSG_SCHEMA_STATUS_ENCODE(code, name, fields, delta, batch) \
+static inline void statusMsgEncode##name(DbfSerializer *dbfSerializer fields(MSG_SCHEMA_PARAM)) \
+{ \
+	messageInitAndAddStatusHeader(dbfSerializer, code); \
+	fields(MSG_SCHEMA_WRITE) \
+}
+
+#define MSG_SCHEMA_STATUS_DECODE(code, name, fields, delta, batch) \
+static inline int statusMsgDecode##name(DbfUnserializer *dbfUnserializer, name##StatusMsg *msg) \
+{ \
+	MSG_SCHEMA_READ_EXPECT(STATUS_CATEGORY) \
+	MSG_SCHEMA_READ(INT64, senderId) \
+	MSG_SCHEMA_READ_EXPECT(code) \
+	fields(MSG_SCHEMA_READ) \
+	return 0; \
+}
+
+// Returns 0 if the message was queued (or added to the batch).
+#ifdef STATUS_BATCH_MS
+#define MSG_SCHEMA_STATUS_SEND_FULL(code, name, fields, delta, batch) \
+static inline int statusMsgSendFull##name(DbfSerializer *dbfSerializer fields(MSG_SCHEMA_PARAM)) \
+{ \
+	if (batch) \
+	{ \
+		dbfSerializer = messageBatchAdd(code); \
+		fields(MSG_SCHEMA_BATCH_WRITE) \
+		int r = messageBatchEnd(); \
+		if (r > 0) \
+		{ \
+			/* The batch was full and has been sent, write the reading again into a new one. */ \
+			dbfSerializer = messageBatchAdd(code); \
+			fields(MSG_SCHEMA_BATCH_WRITE) \
+			r = messageBatchEnd(); \
+		} \
+		return (r == 0) ? 0 : -1; \
+	} \
+	statusMsgEncode##name(dbfSerializer fields(MSG_SCHEMA_ARG)); \
+	return messageSendDbf(dbfSerializer); \
+}
+#else
+#define MSG_SCHEMA_STATUS_SEND_FULL(code, name, fields, delta, batch) \
+static inline int statusMsgSendFull##name(DbfSerializer *dbfSerializer fields(MSG_SCHEMA_PARAM)) \
+{ \
+	statusMsgEncode##name(dbfSerializer fields(MSG_SCHEMA_ARG)); \
+	return messageSendDbf(dbfSerializer); \
+}
+#endif
+
+#ifdef STATUS_DELTA_KEYFRAME
+// Values sent in previous message and how many deltas since keyframe.
+#define MSG_SCHEMA_STATUS_PREVIOUS(code, name, fields, delta, batch) \
+typedef struct \
+{ \
+	unsigned int nOfDeltas; \
+	name##StatusMsg msg; \
+} name##StatusPrevious; \
+extern name##StatusPrevious statusMsgPrevious##name;
+
+#define MSG_SCHEMA_STATUS_SEND_DELTA(code, name, fields, delta, batch) \
+	if (delta) \
+	{ \
+		name##StatusPrevious *previous = &statusMsgPrevious##name; \
+		fields(MSG_SCHEMA_NORMALIZE) \
+		if (previous->nOfDeltas != 0) \
+		{ \
+			dbfSerializer = messageDeltaBegin(dbfSerializer, code, batch); \
+			fields(MSG_SCHEMA_DELTA_WRITE) \
+			const int r = messageDeltaEnd(dbfSerializer, batch); \
+			if (r == 0) \
+			{ \
+				fields(MSG_SCHEMA_SAVE) \
+				previous->nOfDeltas = (previous->nOfDeltas + 1) % STATUS_DELTA_KEYFRAME; \
+			} \
+			if (r <= 0) \
+			{ \
+				return; \
+			} \
+			/* The batch was full and has been sent, the reading goes in full into a new one. */ \
+		} \
+		if (statusMsgSendFull##name(dbfSerializer fields(MSG_SCHEMA_ARG)) == 0) \
+		{ \
+			fields(MSG_SCHEMA_SAVE) \
+			previous->nOfDeltas = 1 % STATUS_DELTA_KEYFRAME; \
+		} \
+		return; \
+	}
+#else
+#define MSG_SCHEMA_STATUS_SEND_DELTA(code, name, fields, delta, batch)
+#endif
+
+#define MSG_SCHEMA_STATUS_SEND(code, name, fields, delta, batch) \
+static inline void statusMsgSend##name(DbfSerializer *dbfSerializer fields(MSG_SCHEMA_PARAM)) \
+{ \
+	MSG_SCHEMA_STATUS_SEND_DELTA(code, name, fields, delta, batch) \
+	statusMsgSendFull##name(dbfSerializer fields(MSG_SCHEMA_ARG)); \
+}
+
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_STRUCT)
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_ENCODE)
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_DECODE)
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_SEND_FULL)
+#ifdef STATUS_DELTA_KEYFRAME
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_PREVIOUS)
+// Next status message of each type is sent in full, used when a batch with
+// differences in it could not be sent.
+void statusMsgForceKeyframes();
+#endif
+STATUS_MESSAGE_TABLE(MSG_SCHEMA_STATUS_SEND)
+
+
+/*
+For each log message this gives (using ErrorAssert as example):
+  ErrorAssertLogMsg
+  logMsgEncodeErrorAssert(dbfSerializer, msg, file, line)
+  logMsgDecodeErrorAssert(dbfUnserializer, msg)
+*/
+#define MSG_SCHEMA_LOG_STRUCT(code, name, fields) \
+typedef struct \
+{ \
+	int64_t senderId; \
+	int64_t sequenceNr; \
+	fields(MSG_SCHEMA_MEMBER) \
+} name##LogMsg;
+
+#define MSG_SCHEMA_LOG_ENCODE(code, name, fields) \
+static inline void logMsgEncode##name(DbfSerializer *dbfSerializer fields(MSG_SCHEMA_PARAM)) \
+{ \
+	logInitAndAddHeader(dbfSerializer, code); \
+	fields(MSG_SCHEMA_WRITE) \
+}
+
+#define MSG_SCHEMA_LOG_DECODE(code, name, fields) \
+static inline int logMsgDecode##name(DbfUnserializer *dbfUnserializer, name##LogMsg *msg) \
+{ \
+	MSG_SCHEMA_READ_EXPECT(LOG_CATEGORY) \
+	MSG_SCHEMA_READ(INT64, senderId) \
+	MSG_SCHEMA_READ(INT64, sequenceNr) \
+	MSG_SCHEMA_READ_EXPECT(code) \
+	fields(MSG_SCHEMA_READ) \
+	return 0; \
+}
+
+LOG_MESSAGE_TABLE(MSG_SCHEMA_LOG_STRUCT)
+LOG_MESSAGE_TABLE(MSG_SCHEMA_LOG_ENCODE)
+LOG_MESSAGE_TABLE(MSG_SCHEMA_LOG_DECODE)
+
+
+/*
+For each command this gives (using Set as example):
+  SetCommandMsg
+  commandMsgEncodeSet(dbfSerializer, destId, refNr, parameter, value)
+  commandMsgDecodeSet(dbfUnserializer, msg)
+*/
+#define MSG_SCHEMA_COMMAND_STRUCT(code, name, fields) \
+typedef struct \
+{ \
+	int64_t senderId; \
+	int64_t destId; \
+	int64_t refNr; \
+	fields(MSG_SCHEMA_MEMBER) \
+} name##CommandMsg;
+
+#define MSG_SCHEMA_COMMAND_ENCODE(code, name, fields) \
+static inline void commandMsgEncode##name(DbfSerializer *dbfSerializer, int64_t destId, int64_t refNr fields(MSG_SCHEMA_PARAM)) \
+{ \
+	messageInitAndAddCategoryAndSender(dbfSerializer, COMMAND_CATEGORY); \
+	DbfSerializerWriteInt64(dbfSerializer, destId); \
+	DbfSerializerWriteInt64(dbfSerializer, refNr); \
+	DbfSerializerWriteInt32(dbfSerializer, code); \
+	fields(MSG_SCHEMA_WRITE) \
+}
+
+#define MSG_SCHEMA_COMMAND_DECODE(code, name, fields) \
+static inline int commandMsgDecode##name(DbfUnserializer *dbfUnserializer, name##CommandMsg *msg) \
+{ \
+	MSG_SCHEMA_READ_EXPECT(COMMAND_CATEGORY) \
+	MSG_SCHEMA_READ(INT64, senderId) \
+	MSG_SCHEMA_READ(INT64, destId) \
+	MSG_SCHEMA_READ(INT64, refNr) \
+	MSG_SCHEMA_READ_EXPECT(code) \
+	fields(MSG_SCHEMA_READ) \
+	return 0; \
+}
+
+COMMAND_MESSAGE_TABLE(MSG_SCHEMA_COMMAND_STRUCT)
+COMMAND_MESSAGE_TABLE(MSG_SCHEMA_COMMAND_ENCODE)
+COMMAND_MESSAGE_TABLE(MSG_SCHEMA_COMMAND_DECODE)
+
+
+#if (defined __linux__) || (defined __WIN32) || (defined DEBUG_DECODE_DBF)
+// These decode the fields following the header (the header shall already
+// have been read) to text, like "timeMs=1000 voltage=231.5 frequency=0".
+// Returns number of characters written or -1 if code is not in the table.
+// For status messages the values are remembered per sender so that a
+// following DELTA_STATUS_MSG (isDelta) can be shown with full values.
+// TIME fields are given relative timeBase (only used if not isDelta).
+int statusMsgFieldsToString(int code, int64_t senderId, int64_t timeBase, int isDelta, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize);
+int logMsgFieldsToString(int code, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize);
+int commandMsgFieldsToString(int code, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize);
+#endif
+
+#endif
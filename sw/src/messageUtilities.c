@@ -13,6 +13,11 @@ Henrik Bjorkman
 
 */
 
+#include <stddef.h>
+#include <string.h>
+#if (defined __linux__) || (defined __WIN32)
+#include <stdio.h>
+#endif
 #include "cfg.h"
 #include "miscUtilities.h"
 #include "systemInit.h"
@@ -23,29 +28,93 @@ Henrik Bjorkman
 #include "log.h"
 #include "serialDev.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
+
 
+static char messageDbfTmpData[DBF_SERIALIZER_BUFFER_SIZE];
 
 DbfSerializer messageDbfTmpBuffer =
 {
-	{0},
-	0,
+	messageDbfTmpData,
+	sizeof(messageDbfTmpData),
 	0
-//#ifdef __linux__
-//	,0
-//#endif
 };
 
 
-#if (defined __linux__) || (defined __WIN32)
-// Not implemented
-#else
+/*
+The first codes of a message (category, sender ID and for status messages
+also the status message type) are the same every time. They are encoded
+once and saved, messages then start with a copy of the saved template.
+Templates are made when first needed and redone if ee.deviceId is changed.
+*/
+#define MESSAGE_CATEGORY_TEMPLATES (REPLY_NOK_CATEGORY + 1)
+#define MESSAGE_STATUS_TEMPLATES (SERIAL_STATS_STATUS_MSG + 1)
+
+static DbfTemplate messageCategoryTemplates[MESSAGE_CATEGORY_TEMPLATES];
+static DbfTemplate messageStatusTemplates[MESSAGE_STATUS_TEMPLATES];
+static uint64_t messageTemplatesDeviceId = 0;
+
+static void messageCheckTemplates()
+{
+	if (messageTemplatesDeviceId != ee.deviceId)
+	{
+		for(int i = 0; i < MESSAGE_CATEGORY_TEMPLATES; i++)
+		{
+			messageCategoryTemplates[i].len = 0;
+		}
+		for(int i = 0; i < MESSAGE_STATUS_TEMPLATES; i++)
+		{
+			messageStatusTemplates[i].len = 0;
+		}
+		messageTemplatesDeviceId = ee.deviceId;
+	}
+}
+
 void messageInitAndAddCategoryAndSender(DbfSerializer *dbfSerializer, MESSAGE_CATEGORY category)
 {
+	messageCheckTemplates();
+
+	if ((category >= 0) && (category < MESSAGE_CATEGORY_TEMPLATES))
+	{
+		DbfTemplate *dbfTemplate = &messageCategoryTemplates[category];
+		if (dbfTemplate->len != 0)
+		{
+			DbfSerializerInitFromTemplate(dbfSerializer, dbfTemplate);
+			return;
+		}
+		DbfSerializerInit(dbfSerializer);
+		DbfSerializerWriteInt32(dbfSerializer, category);
+		DbfSerializerWriteInt64(dbfSerializer, ee.deviceId);
+		DbfTemplateSave(dbfTemplate, dbfSerializer);
+		return;
+	}
+
 	DbfSerializerInit(dbfSerializer);
 	DbfSerializerWriteInt32(dbfSerializer, category);
 	DbfSerializerWriteInt64(dbfSerializer, ee.deviceId);
 }
-#endif
+
+void messageInitAndAddStatusHeader(DbfSerializer *dbfSerializer, STATUS_MESSAGES msg)
+{
+	messageCheckTemplates();
+
+	if ((msg >= 0) && (msg < MESSAGE_STATUS_TEMPLATES))
+	{
+		DbfTemplate *dbfTemplate = &messageStatusTemplates[msg];
+		if (dbfTemplate->len != 0)
+		{
+			DbfSerializerInitFromTemplate(dbfSerializer, dbfTemplate);
+			return;
+		}
+		messageInitAndAddCategoryAndSender(dbfSerializer, STATUS_CATEGORY);
+		DbfSerializerWriteInt32(dbfSerializer, msg);
+		DbfTemplateSave(dbfTemplate, dbfSerializer);
+		return;
+	}
+
+	messageInitAndAddCategoryAndSender(dbfSerializer, STATUS_CATEGORY);
+	DbfSerializerWriteInt32(dbfSerializer, msg);
+}
 
 
 
@@ -96,6 +165,24 @@ void messageReplyToGetCommand(int32_t parameterId, int64_t value, int64_t replyT
 
 #if (defined __linux__) || (defined __WIN32) || (defined DEBUG_DECODE_DBF)
 
+// Helper for the message decoders below. Takes the result from one of the
+// FieldsToString functions in messageSchema.c, if the message was not in the
+// schema (n<0) it is decoded without field names. Fields not in the schema
+// are appended.
+static int fieldsToString(int n, DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
+{
+	int c = (n < 0) ? 0 : n;
+	if (!DbfUnserializerReadIsNextEnd(dbfUnserializer) && (c < bufSize))
+	{
+		if (c > 0)
+		{
+			c += utility_strccpy(bufPtr+c, " ", bufSize-c);
+		}
+		c += DbfUnserializerReadAllToString(dbfUnserializer, bufPtr+c, bufSize-c);
+	}
+	return c;
+}
+
 int decodeCommandMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
 {
 	int c = 0;
@@ -121,7 +208,7 @@ int decodeCommandMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr,
 		c += utility_lltoa(cmdMsgType, bufPtr+c, 10, bufSize-c);
 	}
 
-	c += utility_strccpy(bufPtr+c, "from ", bufSize-c);
+	c += utility_strccpy(bufPtr+c, " from ", bufSize-c);
 	c += utility_lltoa(senderId, bufPtr+c, 10, bufSize-c);
 
 	if (destId==-1)
@@ -137,33 +224,8 @@ int decodeCommandMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr,
 
 	c += utility_lltoa(refNr, bufPtr+c, 10, bufSize-c);
 
-	switch(cmdMsgType)
-	{
-		case SET_CMD:
-		{
-			const int parId = DbfUnserializerReadInt32(dbfUnserializer);
-			const char* parameterName = getParameterName(parId);
-			if (parameterName)
-			{
-				c += utility_strccpy(bufPtr+c, ", ", bufSize-c);
-				c += utility_strccpy(bufPtr+c, parameterName, bufSize-c);
-			}
-			else
-			{
-				c += utility_strccpy(bufPtr+c, ", parameter", bufSize-c);
-				c += utility_lltoa(cmdMsgType, bufPtr+c, 10, bufSize-c);
-			}
-			break;
-		}
-		default:
-		{
-			c += utility_strccpy(bufPtr+c, ",", bufSize-c);
-			break;
-		}
-	}
-
-	c += utility_strccpy(bufPtr, " ", bufSize-c);
-	c += DbfUnserializerReadAllToString(dbfUnserializer, bufPtr+c, bufSize-c);
+	c += utility_strccpy(bufPtr+c, ", ", bufSize-c);
+	c += fieldsToString(commandMsgFieldsToString(cmdMsgType, dbfUnserializer, bufPtr+c, bufSize-c), dbfUnserializer, bufPtr+c, bufSize-c);
 
 	return c;
 }
@@ -198,11 +260,15 @@ int decode_log_message_to_string(DbfUnserializer *dbfUnserializer, char *bufPtr,
 	}
 
 	c += utility_strccpy(bufPtr+c, " ", bufSize-c);
-	c += DbfUnserializerReadAllToString(dbfUnserializer, bufPtr+c, bufSize-c);
+	c += fieldsToString(logMsgFieldsToString(logMessageTypeCode, dbfUnserializer, bufPtr+c, bufSize-c), dbfUnserializer, bufPtr+c, bufSize-c);
 
 	return c;
 }
 
+// Room needed to give one reading of a batch as text. The numbers take
+// up to 20 characters but utility_lltoa wants room for 32.
+#define MESSAGE_BATCH_READING_TEXT_SIZE 160
+
 int decodeStatusMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
 {
 	int c = 0;
@@ -212,8 +278,16 @@ int decodeStatusMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr,
 		return c;
 	}
 
-	/*const int64_t senderId =*/ DbfUnserializerReadInt64(dbfUnserializer);
-	const int statusMsgTypeCode = DbfUnserializerReadInt32(dbfUnserializer);
+	const int64_t senderId = DbfUnserializerReadInt64(dbfUnserializer);
+	int statusMsgTypeCode = DbfUnserializerReadInt32(dbfUnserializer);
+	int isDelta = 0;
+
+	if (statusMsgTypeCode == DELTA_STATUS_MSG)
+	{
+		c += utility_strccpy(bufPtr+c, "DELTA ", bufSize-c);
+		statusMsgTypeCode = DbfUnserializerReadInt32(dbfUnserializer);
+		isDelta = 1;
+	}
 
 	const char* statusMsgTypeName = getStatusMessagesName(statusMsgTypeCode);
 
@@ -228,7 +302,52 @@ int decodeStatusMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr,
 	}
 
 	c += utility_strccpy(bufPtr+c, " ", bufSize-c);
-	c += DbfUnserializerReadAllToString(dbfUnserializer, bufPtr+c, bufSize-c);
+
+	if (statusMsgTypeCode == BATCH_STATUS_MSG)
+	{
+		const int64_t batchTimeMs = DbfUnserializerReadInt64(dbfUnserializer);
+		c += utility_strccpy(bufPtr+c, "timeMs=", bufSize-c);
+		c += utility_lltoa(batchTimeMs, bufPtr+c, 10, bufSize-c);
+		while (!DbfUnserializerReadIsNextEnd(dbfUnserializer))
+		{
+			if (bufSize - c < MESSAGE_BATCH_READING_TEXT_SIZE)
+			{
+				c += utility_strccpy(bufPtr+c, ", ...", bufSize-c);
+				break;
+			}
+			int readingTypeCode = DbfUnserializerReadInt32(dbfUnserializer);
+			int readingIsDelta = 0;
+			c += utility_strccpy(bufPtr+c, ", ", bufSize-c);
+			if (readingTypeCode == DELTA_STATUS_MSG)
+			{
+				c += utility_strccpy(bufPtr+c, "DELTA ", bufSize-c);
+				readingTypeCode = DbfUnserializerReadInt32(dbfUnserializer);
+				readingIsDelta = 1;
+			}
+			const char* readingTypeName = getStatusMessagesName(readingTypeCode);
+			if (readingTypeName != NULL)
+			{
+				c += utility_strccpy(bufPtr+c, readingTypeName, bufSize-c);
+			}
+			else
+			{
+				c += utility_strccpy(bufPtr+c, "StatusMsg", bufSize-c);
+				c += utility_lltoa(readingTypeCode, bufPtr+c, 10, bufSize-c);
+			}
+			c += utility_strccpy(bufPtr+c, " ", bufSize-c);
+			const int n = statusMsgFieldsToString(readingTypeCode, senderId, batchTimeMs, readingIsDelta, dbfUnserializer, bufPtr+c, bufSize-c);
+			if (n < 0)
+			{
+				// Not known how long it is, rest is decoded without field names.
+				c += DbfUnserializerReadAllToString(dbfUnserializer, bufPtr+c, bufSize-c);
+				break;
+			}
+			c += n;
+		}
+		return c;
+	}
+
+	c += fieldsToString(statusMsgFieldsToString(statusMsgTypeCode, senderId, 0, isDelta, dbfUnserializer, bufPtr+c, bufSize-c), dbfUnserializer, bufPtr+c, bufSize-c);
 
 	return c;
 }
@@ -352,7 +471,7 @@ void linux_sim_log_message_from_target(const DbfReceiver *dbfReceiver)
 	{
 		char str[4096];
 		DbfUnserializer dbfUnserializer;
-		DbfUnserializerInit(&dbfUnserializer, dbfReceiver->buffer, dbfReceiver->msgSize);
+		DbfUnserializerInitFromReceiver(&dbfUnserializer, dbfReceiver);
 		DbfUnserializerReadAllToString(&dbfUnserializer, str, sizeof(str));
 		printf(LOG_PREFIX "raw: %s" LOG_SUFIX,str);
 	}
@@ -391,40 +510,45 @@ void messageLogBuffer(const char *prefix, const unsigned char *bufPtr, int bufLe
 #endif
 
 
-#if (defined __linux__) || (defined __WIN32)
-
-void messageSendDbf(DbfSerializer *bytePacket)
+#if (defined COMMAND_ON_USART1) || (defined COMMAND_ON_LPUART1) || (defined COMMAND_ON_USART2)
+// Sends the message with begin and end codes. If it does not fit in the
+// send buffer nothing is sent (that is counted, see serialGetStats).
+// Returns 0 if OK, -1 if not sent.
+static int messageSendFrame(int usartDev, const char *msgPtr, int msgLen)
 {
-	// TODO
+	const char begin = DBF_BEGIN_CODEID;
+	const char end = DBF_END_CODEID;
+	const SerialSpan spans[] = {
+		{&begin, 1},
+		{msgPtr, msgLen},
+		{&end, 1},
+	};
+	return serialWriteFrame(usartDev, spans, sizeof(spans)/sizeof(spans[0]));
 }
+#endif
 
-void messageSendShortDbf(int32_t code)
-{
-	// TODO
-}
-#error
-
-#else
-
-void messageSendDbf(DbfSerializer *bytePacket)
+// Returns 0 if OK, -1 if the message was dropped (on one or more ports).
+int messageSendDbf(DbfSerializer *bytePacket)
 {
 	DbfSerializerWriteCrc(bytePacket);
+	if (DbfSerializerIsOverflow(bytePacket))
+	{
+		// Better to not send it at all than to send an incomplete message.
+		debug_print("messageSendDbf overflow\n");
+		DbfSerializerInit(bytePacket);
+		return -1;
+	}
 	const char *msgPtr=DbfSerializerGetMsgPtr(bytePacket);
 	const int msgLen=DbfSerializerGetMsgLen(bytePacket);
+	int result = 0;
 	#ifdef COMMAND_ON_USART1
-	serialPutChar(DEV_USART1, DBF_BEGIN_CODEID);
-	serialWrite(DEV_USART1, msgPtr, msgLen);
-	serialPutChar(DEV_USART1, DBF_END_CODEID);
+	result |= messageSendFrame(DEV_USART1, msgPtr, msgLen);
 	#endif
 	#ifdef COMMAND_ON_LPUART1
-	serialPutChar(DEV_LPUART1, DBF_BEGIN_CODEID);
-	serialWrite(DEV_LPUART1, msgPtr, msgLen);
-	serialPutChar(DEV_LPUART1, DBF_END_CODEID);
+	result |= messageSendFrame(DEV_LPUART1, msgPtr, msgLen);
 	#endif
 	#ifdef COMMAND_ON_USART2
-	serialPutChar(DEV_USART2, DBF_BEGIN_CODEID);
-	serialWrite(DEV_USART2, msgPtr, msgLen);
-	serialPutChar(DEV_USART2, DBF_END_CODEID);
+	result |= messageSendFrame(DEV_USART2, msgPtr, msgLen);
 	#endif
 
 	#ifdef DEBUG_DECODE_DBF
@@ -436,17 +560,165 @@ void messageSendDbf(DbfSerializer *bytePacket)
 	#endif
 
 	DbfSerializerInit(bytePacket);
+	return result;
 }
 
-void messageSendShortDbf(int32_t code)
+#ifdef STATUS_BATCH_MS
+
+/*
+BATCH_STATUS_MSG
+	<batch time>
+		In milli seconds, see systemGetSysTimeMs.
+	Then for each reading:
+	<status message type>
+	<status message body>
+		Same as in the status message of its own except that TIME fields
+		are given relative to the batch time, see messageSchema.h.
+*/
+
+// Room that must be left for the CRC code, 32 bits of which
+// DBF_FMTCRC_DATANBITS are in the first byte, see messageSendDbf.
+#define MESSAGE_BATCH_CRC_SIZE (1 + (32 - DBF_FMTCRC_DATANBITS + DBF_EXT_DATANBITS - 1) / DBF_EXT_DATANBITS)
+
+static char messageBatchData[DBF_SERIALIZER_BUFFER_SIZE];
+static DbfSerializer messageBatch = {messageBatchData, sizeof(messageBatchData), 0};
+static int64_t messageBatchTimeMs = 0;
+static int messageBatchNOfReadings = 0;
+
+// The batch as it was before the reading being added, so that the reading
+// can be taken back if it does not fit. Only a repetition code at the end
+// can be changed by what is written after it (see DbfSerializerWriteRepeat)
+// so that is all of the buffer that needs to be saved.
+static DbfSerializer messageBatchBeforeReading;
+static char messageBatchRepeatCode[DBF_MAX_EXT_CODES + 1];
+static unsigned int messageBatchRepeatCodeLen = 0;
+
+static void messageBatchSend()
 {
-	DbfSerializerInit(&messageDbfTmpBuffer);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, code);
-	messageSendDbf(&messageDbfTmpBuffer);
+	if (messageBatchNOfReadings > 0)
+	{
+		#ifdef STATUS_DELTA_KEYFRAME
+		if (messageSendDbf(&messageBatch) != 0)
+		{
+			// Differences in the batch are lost, next ones need a keyframe to be relative to.
+			statusMsgForceKeyframes();
+		}
+		#else
+		messageSendDbf(&messageBatch);
+		#endif
+		messageBatchNOfReadings = 0;
+	}
+}
+
+DbfSerializer* messageBatchAdd(STATUS_MESSAGES msg)
+{
+	if (messageBatchNOfReadings == 0)
+	{
+		messageBatchTimeMs = systemGetSysTimeMs();
+		messageInitAndAddStatusHeader(&messageBatch, BATCH_STATUS_MSG);
+		DbfSerializerWriteInt64(&messageBatch, messageBatchTimeMs);
+	}
+
+	messageBatchBeforeReading = messageBatch;
+	messageBatchRepeatCodeLen = 0;
+	if ((messageBatch.repeatCount > 0) && (messageBatch.pos - messageBatch.repeatPos <= sizeof(messageBatchRepeatCode)))
+	{
+		messageBatchRepeatCodeLen = messageBatch.pos - messageBatch.repeatPos;
+		memcpy(messageBatchRepeatCode, messageBatch.buffer + messageBatch.repeatPos, messageBatchRepeatCodeLen);
+	}
+
+	messageBatchNOfReadings++;
+	DbfSerializerWriteInt32(&messageBatch, msg);
+	return &messageBatch;
+}
+
+int messageBatchEnd()
+{
+	if ((!DbfSerializerIsOverflow(&messageBatch)) && (messageBatch.capacity - messageBatch.pos >= MESSAGE_BATCH_CRC_SIZE))
+	{
+		return 0;
+	}
+
+	if (messageBatchNOfReadings == 1)
+	{
+		// Does not fit even in an empty batch.
+		messageBatchNOfReadings = 0;
+		return -1;
+	}
+
+	// Take the reading back and send the readings before it.
+	messageBatch = messageBatchBeforeReading;
+	memcpy(messageBatch.buffer + messageBatch.repeatPos, messageBatchRepeatCode, messageBatchRepeatCodeLen);
+	messageBatchNOfReadings--;
+	messageBatchSend();
+	return 1;
+}
+
+int64_t messageBatchGetTimeMs()
+{
+	return messageBatchTimeMs;
+}
+
+void messageBatchMediumTick()
+{
+	if ((messageBatchNOfReadings > 0) && ((systemGetSysTimeMs() - messageBatchTimeMs) >= STATUS_BATCH_MS))
+	{
+		messageBatchSend();
+	}
+}
+
+#endif
+
+#ifdef STATUS_DELTA_KEYFRAME
+
+/*
+DELTA_STATUS_MSG
+	<status message type>
+	<status message body>
+		The fields are given as the difference from the previous message of
+		the same type, see MSG_SCHEMA_DELTA_WRITE in messageSchema.h. The
+		first and then every STATUS_DELTA_KEYFRAME:th message is sent in full.
+In a batch (see BATCH_STATUS_MSG) a DELTA_STATUS_MSG is given as the type
+of the reading followed by the above.
+*/
+
+DbfSerializer* messageDeltaBegin(DbfSerializer *dbfSerializer, STATUS_MESSAGES msg, int batch)
+{
+	#ifdef STATUS_BATCH_MS
+	if (batch)
+	{
+		dbfSerializer = messageBatchAdd(DELTA_STATUS_MSG);
+		DbfSerializerWriteInt32(dbfSerializer, msg);
+		return dbfSerializer;
+	}
+	#endif
+	messageInitAndAddStatusHeader(dbfSerializer, DELTA_STATUS_MSG);
+	DbfSerializerWriteInt32(dbfSerializer, msg);
+	return dbfSerializer;
+}
+
+int messageDeltaEnd(DbfSerializer *dbfSerializer, int batch)
+{
+	#ifdef STATUS_BATCH_MS
+	if (batch)
+	{
+		return messageBatchEnd();
+	}
+	#endif
+	return messageSendDbf(dbfSerializer);
 }
 
 #endif
 
+void messageSendShortDbf(int32_t code)
+{
+	char buf[16];
+	DbfSerializer dbfSerializer;
+	DbfSerializerInitBuffer(&dbfSerializer, buf, sizeof(buf));
+	DbfSerializerWriteInt32(&dbfSerializer, code);
+	messageSendDbf(&dbfSerializer);
+}
+
 
 #if (defined __linux__) || (defined __WIN32) || (defined DEBUG_DECODE_DBF)
 
@@ -479,6 +751,62 @@ void DbfUnserializerReadCrcAndLog(DbfUnserializer *dbfUnserializer)
 }*/
 
 
+// Gives mantissa * 10^exponent as text, like "231.5" or "-0.0012".
+// Scientific notation is used if the exponent is large, like "15e20".
+int decimalToString(int64_t mantissa, int32_t exponent, char *bufPtr, int bufSize)
+{
+	char digits[32];
+	char tmp[64];
+	int c = 0;
+
+	if (mantissa < 0)
+	{
+		tmp[c++] = '-';
+	}
+	const int n = utility_lltoa((mantissa < 0) ? -mantissa : mantissa, digits, 10, sizeof(digits));
+
+	if ((exponent >= 0) && (exponent <= 6))
+	{
+		c += utility_strccpy(tmp+c, digits, sizeof(tmp)-c);
+		for(int i = 0; i < exponent; i++)
+		{
+			tmp[c++] = '0';
+		}
+	}
+	else if ((exponent < 0) && (exponent >= -18))
+	{
+		const int nOfDecimals = -exponent;
+		if (n > nOfDecimals)
+		{
+			for(int i = 0; i < n - nOfDecimals; i++)
+			{
+				tmp[c++] = digits[i];
+			}
+			tmp[c++] = '.';
+			c += utility_strccpy(tmp+c, digits + n - nOfDecimals, sizeof(tmp)-c);
+		}
+		else
+		{
+			tmp[c++] = '0';
+			tmp[c++] = '.';
+			for(int i = n; i < nOfDecimals; i++)
+			{
+				tmp[c++] = '0';
+			}
+			c += utility_strccpy(tmp+c, digits, sizeof(tmp)-c);
+		}
+	}
+	else
+	{
+		c += utility_strccpy(tmp+c, digits, sizeof(tmp)-c);
+		tmp[c++] = 'e';
+		c += utility_lltoa(exponent, tmp+c, 10, sizeof(tmp)-c);
+	}
+	tmp[c] = 0;
+
+	return utility_strccpy(bufPtr, tmp, bufSize);
+}
+
 // Reads the remaining message and logs its contents.
 int DbfUnserializerReadAllToString(DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize)
 {
@@ -506,9 +834,39 @@ int DbfUnserializerReadAllToString(DbfUnserializer *dbfUnserializer, char *bufPt
 			c += utility_strccpy(bufPtr+c, separator, bufSize);
 			c += utility_lltoa(i, bufPtr+c, 10, bufSize-c);
 		}
+		else if (DbfUnserializerReadIsNextDecimal(dbfUnserializer))
+		{
+			int64_t mantissa;
+			int32_t exponent;
+			DbfUnserializerReadDecimal(dbfUnserializer, &mantissa, &exponent);
+			c += utility_strccpy(bufPtr+c, separator, bufSize-c);
+			c += decimalToString(mantissa, exponent, bufPtr+c, bufSize-c);
+		}
+		else if (DbfUnserializerReadIsNextArray(dbfUnserializer))
+		{
+			DbfArray dbfArray;
+			c += utility_strccpy(bufPtr+c, separator, bufSize-c);
+			c += utility_strccpy(bufPtr+c, "[", bufSize-c);
+			const int n = DbfUnserializerReadArray(dbfUnserializer, &dbfArray);
+			for(int k = 0; k < n; k++)
+			{
+				c += utility_strccpy(bufPtr+c, (k == 0) ? "" : " ", bufSize-c);
+				int32_t i;
+				switch(dbfArray.elementSize)
+				{
+					case 1: i = DbfArrayGetUint8(&dbfArray, k); break;
+					case 2: i = DbfArrayGetInt16(&dbfArray, k); break;
+					default: i = DbfArrayGetInt32(&dbfArray, k); break;
+				}
+				c += utility_lltoa(i, bufPtr+c, 10, bufSize-c);
+			}
+			c += utility_strccpy(bufPtr+c, "]", bufSize-c);
+		}
 		else
 		{
-			c += utility_strccpy(bufPtr, " ?", bufSize);
+			// Unknown format, nothing more can be decoded.
+			c += utility_strccpy(bufPtr+c, " ?", bufSize-c);
+			break;
 		}
 		separator=" ";
 	}
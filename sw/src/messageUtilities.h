@@ -19,6 +19,9 @@ Henrik Bjorkman
 
 void messageInitAndAddCategoryAndSender(DbfSerializer *dbfSerializer, MESSAGE_CATEGORY category);
 
+// Init and add the header of a status message, category, sender and status message type.
+void messageInitAndAddStatusHeader(DbfSerializer *dbfSerializer, STATUS_MESSAGES msg);
+
 void messageReplyOkInitAndAddHeader(COMMAND_CODES cmd, int64_t replyToId, int64_t replyToRef);
 
 void messageReplyOK(COMMAND_CODES cmd, int64_t replyToId, int64_t replyToRef);
@@ -33,10 +36,37 @@ void messageLogBuffer(const char* prefix, const unsigned char *bufPtr, int bufLe
 
 extern DbfSerializer messageDbfTmpBuffer;
 
-void messageSendDbf(DbfSerializer *bytePacket);
+// Returns 0 if OK, -1 if the message was dropped (did not fit).
+int messageSendDbf(DbfSerializer *bytePacket);
 
 void messageSendShortDbf(int32_t code);
 
+#ifdef STATUS_BATCH_MS
+// Begin adding a reading of type msg to the batch. Returns the serializer to
+// write the fields of the reading to, then call messageBatchEnd. See also
+// messageSchema.h.
+DbfSerializer* messageBatchAdd(STATUS_MESSAGES msg);
+// Returns 0 if the reading fitted in the batch, -1 if it was dropped (it is
+// too large for any batch). If it did not fit the batch is taken back to
+// before the reading and sent, then 1 is returned and the reading shall be
+// added again (into a new batch).
+int messageBatchEnd();
+// The time that TIME fields in the batch are relative to.
+int64_t messageBatchGetTimeMs();
+// Sends the batch when STATUS_BATCH_MS has passed since it was started.
+void messageBatchMediumTick();
+#endif
+
+#ifdef STATUS_DELTA_KEYFRAME
+// Begin a DELTA_STATUS_MSG for status message type msg. Returns the
+// serializer to write the differences to (the batch if STATUS_BATCH_MS
+// and batch is nonzero).
+DbfSerializer* messageDeltaBegin(DbfSerializer *dbfSerializer, STATUS_MESSAGES msg, int batch);
+// Sends the message, unless it is in the batch. Returns 0 if OK, for a
+// reading in the batch same as messageBatchEnd.
+int messageDeltaEnd(DbfSerializer *dbfSerializer, int batch);
+#endif
+
 
 #if (defined __linux__) || (defined __WIN32) || (defined DEBUG_DECODE_DBF)
 int decodeCommandMessageToString(DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize);
@@ -46,6 +76,7 @@ void linux_sim_log_message_from_target(const DbfReceiver *dbfReceiver);
 void DbfUnserializerReadCrcAndLog(DbfUnserializer *dbfUnserializer);
 int DbfUnserializerReadAllToString(DbfUnserializer *dbfUnserializer, char *bufPtr, int bufSize);
 int DbfReceiverLogRawData(const DbfReceiver *dbfReceiver);
+int decimalToString(int64_t mantissa, int32_t exponent, char *bufPtr, int bufSize);
 #endif
 
 
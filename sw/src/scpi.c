@@ -29,6 +29,7 @@ The purpose of this is to process messages from an external voltage sensor.
 #include <inttypes.h>
 #include "debugLog.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 #include "serialDev.h"
 
 
@@ -60,6 +61,14 @@ static int64_t voltage_mv0=0;
 
 
 static int64_t voltage_mv=0;
+
+// The readings as given by the multimeter, mantissa * 10^exponent.
+static int64_t voltage_m2=0;
+static int64_t voltage_m1=0;
+static int64_t voltage_m0=0;
+static int32_t voltage_e2=0;
+static int32_t voltage_e1=0;
+static int32_t voltage_e0=0;
 //static int senderState=0;
 //static int senderCounter=0;
 
@@ -112,26 +121,6 @@ static int my_stricmp(const char *str1, const char *str2)
 }
 
 
-static const char * decodeDigits(const char *str, int64_t *result, int *nOfDigits)
-{
-    for(;;)
-    {
-    	int ch=*str;
-    	if (my_isdigit(ch))
-    	{
-    		*result = (10 * (*result)) + (ch - '0');
-    		++(*nOfDigits);
-    		++str;
-    	}
-    	else
-    	{
-    		break;
-    	}
-    }
-    return str;
-}
-
-
 static const char* decodeIntegerNumber(const char *str, int64_t *result)
 {
 	int isNegative = 0;
@@ -175,22 +164,16 @@ static const char* decodeIntegerNumber(const char *str, int64_t *result)
 
 /**
 This function decodes the SCPI "Numeric Representation format".
-
-Give precision as:
-	3 if millis are wanted
-	6 if micros
+The result is given as mantissa * 10^exponent so that no precision is lost.
+Example: "-5.263926e-1" gives mantissa = -5263926, exponent = -7
 
 Returns:
     0 : OK
    <0 : Not OK
 */
-static int decodeScientific(const char *str, int precision, int64_t *result)
+static int decodeScientific(const char *str, int64_t *mantissa, int32_t *exponent)
 {
-	// decode integer, decimals and exponent.
-	int64_t i=0, d=0, e=0;
-	int n=0;
-	// Example for values of i,d,e
-	// -5.263926e-1  then i = -5, d = 263926, e = -1, n = 6
+	int64_t m=0, e=0;
 
 	while(my_isspace(*str))
 	{
@@ -214,74 +197,89 @@ static int decodeScientific(const char *str, int precision, int64_t *result)
 		return -1;
 	}
 
-	str=decodeIntegerNumber(str, &i);
-
-	if (*str == '.')
+	// Integer part and decimals, if there are more digits than
+	// fit in 64 bits the least significant ones are dropped.
+	int isDecimal = 0;
+	for(;;)
 	{
+		const int ch = *str;
+		if (my_isdigit(ch))
+		{
+			if (m < (INT64_MAX / 10 - 9))
+			{
+				m = (10 * m) + (ch - '0');
+				if (isDecimal)
+				{
+					--e;
+				}
+			}
+			else if (!isDecimal)
+			{
+				++e;
+			}
+		}
+		else if ((ch == '.') && (!isDecimal))
+		{
+			isDecimal = 1;
+		}
+		else
+		{
+			break;
+		}
 		++str;
-		str= decodeDigits(str, &d, &n);
 	}
 
 	if ((*str == 'e') || (*str == 'E'))
 	{
+		int64_t x=0;
 		++str;
-		str=decodeIntegerNumber(str, &e);
-	}
-
-	e+=precision;
-
-	if (e>16)
-	{
-		// Out of range for 64 bit integer.
-		return -2;
-	}
-
-	if (e<-50)
-	{
-		// rounded to zero for an integer.
-		*result = 0;
-		return 0;
+		str=decodeIntegerNumber(str, &x);
+		if ((x > 1000) || (x < -1000))
+		{
+			// Not a reasonable reading.
+			return -2;
+		}
+		e += x;
 	}
 
+	*mantissa = isNegative ? -m : m;
+	*exponent = e;
+	return 0;
+}
 
-	// from decimals keep only as many as e say.
-	while (n>e)
-	{
-		d = d/10;
-		--n;
-	}
+/**
+Convert mantissa * 10^exponent to fixed point.
 
+Give precision as:
+	3 if millis are wanted
+	6 if micros
 
-	// Or if number of digits is less then add some.
-	while (n<e)
-	{
-		d = d*10;
-		++n;
-	}
+Returns:
+    0 : OK
+   <0 : Not OK
+*/
+static int decimalToFixed(int64_t mantissa, int32_t exponent, int precision, int64_t *result)
+{
+	int64_t e = exponent + precision;
 
-	// Adjust integer part also
 	while (e>0)
 	{
-		i *= 10;
+		if ((mantissa > INT64_MAX / 10) || (mantissa < INT64_MIN / 10))
+		{
+			// Out of range for 64 bit integer.
+			return -2;
+		}
+		mantissa *= 10;
 		--e;
 	}
 
-	while (e<0)
+	while ((e<0) && (mantissa != 0))
 	{
-		i /= 10;
+		mantissa /= 10;
 		++e;
 	}
 
-
-	if (isNegative)
-	{
-		*result = -(i + d);
-	}
-	else
-	{
-		*result = i + d;
-	}
-
+	*result = mantissa;
 	return 0;
 }
 
@@ -335,21 +333,19 @@ static int isExpectedMessageReceived(const char *expectedMessage)
 }
 
 
-static void sendVoltageMessage(int64_t voltage_mv)
+// Voltage is given as mantissa * 10^exponent volts.
+static void sendVoltageMessage(int64_t mantissa, int32_t exponent)
 {
 	// printing in ascii was used for debugging, can be removed later.
 	// This should typically be sent on usart2 (USB)
 	debug_print("Voltage ");
-	debug_print64(voltage_mv);
-	debug_print("mv\n");
+	debug_print64(mantissa);
+	debug_print("e");
+	debug_print64(exponent);
+	debug_print("V\n");
 
 	// This should typically be sent on usart1 (opto link)
-	messageInitAndAddCategoryAndSender(&messageDbfTmpBuffer, STATUS_CATEGORY);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, VOLTAGE_STATUS_MSG);
-	DbfSerializerWriteInt64(&messageDbfTmpBuffer, systemGetSysTimeMs());
-	DbfSerializerWriteInt64(&messageDbfTmpBuffer, voltage_mv);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, 0); // reserved for frequency
-	messageSendDbf(&messageDbfTmpBuffer);
+	statusMsgSendVoltage(&messageDbfTmpBuffer, systemGetSysTimeMs(), mantissa, exponent, 0);
 }
 
 static void sendScpiMessage(const char* msg)
@@ -433,12 +429,24 @@ void scpiInit()
 }
 
 
+static void setVoltage(int64_t mv, int64_t mantissa, int32_t exponent)
+{
+	voltage_mv = mv;
+	sendVoltageMessage(mantissa, exponent);
+}
+
 static int scientificMessageReceived()
 {
 	if (!rcvMessageReceived) {return 0;}
 
+	int64_t tmpMantissa;
+	int32_t tmpExponent;
 	int64_t tmpVoltage_mv;
-	int r = decodeScientific(rcvBuffer, 3, &tmpVoltage_mv);
+	int r = decodeScientific(rcvBuffer, &tmpMantissa, &tmpExponent);
+	if (r == 0)
+	{
+		r = decimalToFixed(tmpMantissa, tmpExponent, 3, &tmpVoltage_mv);
+	}
 	if (r == 0)
 	{
 		// Filter out extreme values in case of transmission errors.
@@ -449,42 +457,46 @@ static int scientificMessageReceived()
 		voltage_mv2=voltage_mv1;
 		voltage_mv1=voltage_mv0;
 		voltage_mv0=tmpVoltage_mv;
+		voltage_m2=voltage_m1;
+		voltage_m1=voltage_m0;
+		voltage_m0=tmpMantissa;
+		voltage_e2=voltage_e1;
+		voltage_e1=voltage_e0;
+		voltage_e0=tmpExponent;
 
 		if (nOfvaluesAvailable>=2)
 		{
 			// Find median value of the latest 3 values.
 			if ((voltage_mv0 >= voltage_mv1) && (voltage_mv0 <= voltage_mv2))
 			{
-				voltage_mv = voltage_mv0;
+				setVoltage(voltage_mv0, voltage_m0, voltage_e0);
 			}
 			else if ((voltage_mv0 <= voltage_mv1) && (voltage_mv0 >= voltage_mv2))
 			{
-				voltage_mv = voltage_mv0;
+				setVoltage(voltage_mv0, voltage_m0, voltage_e0);
 			}
 			else if ((voltage_mv1 >= voltage_mv2) && (voltage_mv1 <= voltage_mv0))
 			{
-				voltage_mv = voltage_mv1;
+				setVoltage(voltage_mv1, voltage_m1, voltage_e1);
 			}
 			else if ((voltage_mv1 <= voltage_mv2) && (voltage_mv1 >= voltage_mv0))
 			{
-				voltage_mv = voltage_mv1;
+				setVoltage(voltage_mv1, voltage_m1, voltage_e1);
 			}
 			else if ((voltage_mv2 >= voltage_mv1) && (voltage_mv2 <= voltage_mv0))
 			{
-				voltage_mv = voltage_mv2;
+				setVoltage(voltage_mv2, voltage_m2, voltage_e2);
 			}
 			else if ((voltage_mv2 <= voltage_mv1) && (voltage_mv2 >= voltage_mv0))
 			{
-				voltage_mv = voltage_mv2;
+				setVoltage(voltage_mv2, voltage_m2, voltage_e2);
 			}
 			else
 			{
 				// This should not happen
 				debug_print("Median value of 3 failed.\n");
-				voltage_mv = tmpVoltage_mv;
+				setVoltage(tmpVoltage_mv, tmpMantissa, tmpExponent);
 			}
-
-			sendVoltageMessage(voltage_mv);
 		}
 		else
 		{
@@ -21,6 +21,7 @@ References
 #ifdef SOFTUART1_BAUDRATE
 #include "SoftUart.h"
 #endif
+#include "serialDma.h"
 #include "serialDev.h"
 
 
@@ -31,15 +32,17 @@ void* memset(void* bufptr, int value, unsigned int size);
 #ifdef LPUART1_BAUDRATE
 	//#define LPUART1_TX_PIN 2
 	#define LPUART1_RX_PIN 3
-	volatile struct Fifo lpuart1In = {0,0,{0}};
+	FIFO_DEFINE(lpuart1In, FIFO_BUFFER_SIZE);
 	#ifdef LPUART1_TX_PIN
-	volatile struct Fifo lpuart1Out = {0,0,{0}};
+	FIFO_DEFINE(lpuart1Out, FIFO_BUFFER_SIZE);
 	#endif
 #endif
 
 
-volatile struct Fifo usart1In = {0,0,{0}};
-volatile struct Fifo usart1Out = {0,0,{0}};
+#ifndef USART1_RX_DMA_SIZE
+FIFO_DEFINE(usart1In, USART1_FIFO_SIZE);
+#endif
+FIFO_DEFINE(usart1Out, USART1_FIFO_SIZE);
 
 #ifdef USART2_BAUDRATE
 	// If PA2 is needed by LPUART comment the line below.
@@ -48,13 +51,35 @@ volatile struct Fifo usart1Out = {0,0,{0}};
 	// https://community.st.com/s/question/0D50X00009XkYKK/usart-vcp-connections-on-nucleol432kc
 	#define USART2_TX_PIN 2
 	#define USART2_RX_PIN 15
-	volatile struct Fifo usart2In = {0,0,{0}};
+	#ifndef USART2_RX_DMA_SIZE
+	FIFO_DEFINE(usart2In, USART2_FIFO_SIZE);
+	#endif
 	#ifdef USART2_TX_PIN
-	volatile struct Fifo usart2Out = {0,0,{0}};
+	FIFO_DEFINE(usart2Out, USART2_FIFO_SIZE);
 	#endif
 #endif
 
 
+// Counters not kept by the buffers themselves, see serialGetStats.
+static volatile SerialStats serialCounters[SERIAL_NOF_DEV];
+
+#ifdef USART1_TX_DMA
+	static SerialDmaTx usart1DmaTx;
+#endif
+#if (defined USART2_TX_DMA) && (defined USART2_TX_PIN)
+	static SerialDmaTx usart2DmaTx;
+#endif
+
+#ifdef USART1_RX_DMA_SIZE
+	static char usart1DmaRxBuffer[USART1_RX_DMA_SIZE];
+	static SerialDmaRx usart1DmaRx;
+#endif
+#ifdef USART2_RX_DMA_SIZE
+	static char usart2DmaRxBuffer[USART2_RX_DMA_SIZE];
+	static SerialDmaRx usart2DmaRx;
+#endif
+
+
 // NOTE Two uarts, usarts etc shall not use same pins.
 // For example USART2 and LPUART1 can not both use PA2.
 #if ((defined LPUART1_TX_PIN) && (defined USART2_TX_PIN)) && (LPUART1_TX_PIN==USART2_TX_PIN)
@@ -62,11 +87,35 @@ volatile struct Fifo usart1Out = {0,0,{0}};
 #endif
 
 
+// Count and clear receive errors. ORE must be cleared, if not the
+// interrupt comes again and again.
+static inline void usartCheckErrors(USART_TypeDef *usartPtr, uint32_t isr, volatile SerialStats *counters)
+{
+  if (isr & (USART_ISR_ORE_Msk | USART_ISR_FE_Msk | USART_ISR_NE_Msk))
+  {
+    if (isr & USART_ISR_ORE_Msk)
+    {
+      counters->overrunErrors++;
+    }
+    if (isr & USART_ISR_FE_Msk)
+    {
+      counters->framingErrors++;
+    }
+    if (isr & USART_ISR_NE_Msk)
+    {
+      counters->noiseErrors++;
+    }
+    usartPtr->ICR = USART_ICR_ORECF_Msk | USART_ICR_FECF_Msk | USART_ICR_NECF_Msk;
+  }
+}
+
 #ifdef LPUART1_BAUDRATE
 void __attribute__ ((interrupt, used)) LPUART1_IRQHandler(void)
 {
   volatile uint32_t tmp = LPUART1->ISR;
 
+  serialCounters[DEV_LPUART1].isrEntries++;
+
   // RXNE (Receive not empty)
   if (tmp & USART_ISR_RXNE_Msk)
   {
@@ -74,6 +123,7 @@ void __attribute__ ((interrupt, used)) LPUART1_IRQHandler(void)
     //mainDummy = USART1->RDR;
     fifoPut(&lpuart1In, LPUART1->RDR);
   }
+  usartCheckErrors(LPUART1, tmp, &serialCounters[DEV_LPUART1]);
 
   #ifdef LPUART1_TX_PIN
   // TXE (transmit empty)
@@ -97,14 +147,27 @@ void __attribute__ ((interrupt, used)) USART1_IRQHandler(void)
 {
   volatile uint32_t tmp = USART1->ISR;
 
+  serialCounters[DEV_USART1].isrEntries++;
+
+  #ifdef USART1_RX_DMA_SIZE
+  // IDLE, DMA has received a burst of bytes and now the line is quiet.
+  if (tmp & USART_ISR_IDLE_Msk)
+  {
+    USART1->ICR = USART_ICR_IDLECF_Msk;
+    serialDmaRxUpdate(&usart1DmaRx);
+  }
+  usartCheckErrors(USART1, tmp, &serialCounters[DEV_USART1]);
+  #else
   // RXNE (Receive not empty)
   if (tmp & USART_ISR_RXNE_Msk)
   {
-    // Simple receive, this never happens :(
-    //mainDummy = USART1->RDR;
+    // If there is no room the byte is dropped (and counted) by fifoPut.
     fifoPut(&usart1In, USART1->RDR);
   }
+  usartCheckErrors(USART1, tmp, &serialCounters[DEV_USART1]);
+  #endif
 
+  #ifndef USART1_TX_DMA
   // TXE (transmit empty)
   if (tmp & USART_ISR_TXE_Msk)
   {
@@ -118,6 +181,7 @@ void __attribute__ ((interrupt, used)) USART1_IRQHandler(void)
       USART1->CR1 &= ~(USART_CR1_TXEIE_Msk);
     }
   }
+  #endif
 }
 
 #ifdef USART2_BAUDRATE
@@ -125,17 +189,30 @@ void __attribute__ ((interrupt, used)) USART2_IRQHandler(void)
 {
   volatile uint32_t tmp = USART2->ISR;
 
+  serialCounters[DEV_USART2].isrEntries++;
+
+  #ifdef USART2_RX_DMA_SIZE
+  // IDLE, DMA has received a burst of bytes and now the line is quiet.
+  if (tmp & USART_ISR_IDLE_Msk)
+  {
+    USART2->ICR = USART_ICR_IDLECF_Msk;
+    serialDmaRxUpdate(&usart2DmaRx);
+  }
+  usartCheckErrors(USART2, tmp, &serialCounters[DEV_USART2]);
+  #else
   // RXNE (Receive not empty)
   if (tmp & USART_ISR_RXNE_Msk)
   {
-    // Simple receive, this never happens :(
-    fifoPut(&usart2In, (int)(USART2->RDR & 0xFF));
+    // If there is no room the byte is dropped (and counted) by fifoPut.
+    fifoPut(&usart2In, USART2->RDR & 0xFF);
 
     // For debugging count the RXNE interrupts.
     //mainCh++; // Remove this when things work.
   }
+  usartCheckErrors(USART2, tmp, &serialCounters[DEV_USART2]);
+  #endif
 
-  #ifdef USART2_TX_PIN
+  #if (defined USART2_TX_PIN) && (!defined USART2_TX_DMA)
   // TXE (transmit empty)
   if (tmp & USART_ISR_TXE_Msk)
   {
@@ -156,6 +233,48 @@ void __attribute__ ((interrupt, used)) USART2_IRQHandler(void)
 }
 #endif
 
+#ifdef USART1_TX_DMA
+// Transfer complete on DMA1 channel 4, the bytes given to DMA are sent.
+void __attribute__ ((interrupt, used)) DMA1_Channel4_IRQHandler(void)
+{
+  if (DMA1->ISR & DMA_ISR_TCIF4)
+  {
+    DMA1->IFCR = DMA_IFCR_CTCIF4;
+    serialDmaTxComplete(&usart1DmaTx);
+  }
+}
+#endif
+
+#if (defined USART2_TX_DMA) && (defined USART2_TX_PIN)
+// Transfer complete on DMA1 channel 7.
+void __attribute__ ((interrupt, used)) DMA1_Channel7_IRQHandler(void)
+{
+  if (DMA1->ISR & DMA_ISR_TCIF7)
+  {
+    DMA1->IFCR = DMA_IFCR_CTCIF7;
+    serialDmaTxComplete(&usart2DmaTx);
+  }
+}
+#endif
+
+#ifdef USART1_RX_DMA_SIZE
+// Half transfer or transfer complete on DMA1 channel 5.
+void __attribute__ ((interrupt, used)) DMA1_Channel5_IRQHandler(void)
+{
+  DMA1->IFCR = DMA_IFCR_CHTIF5 | DMA_IFCR_CTCIF5;
+  serialDmaRxUpdate(&usart1DmaRx);
+}
+#endif
+
+#ifdef USART2_RX_DMA_SIZE
+// Half transfer or transfer complete on DMA1 channel 6.
+void __attribute__ ((interrupt, used)) DMA1_Channel6_IRQHandler(void)
+{
+  DMA1->IFCR = DMA_IFCR_CHTIF6 | DMA_IFCR_CTCIF6;
+  serialDmaRxUpdate(&usart2DmaRx);
+}
+#endif
+
 /* This seems to work fine, we do get what the Nucleo sends */
 void setupIoPinTx(GPIO_TypeDef *base, uint32_t pin, uint32_t alternateFunction)
 {
@@ -322,6 +441,188 @@ int usartGetIrqN(int usartNr)
   return 0;
 }
 
+#if (defined USART1_TX_DMA) || ((defined USART2_TX_DMA) && (defined USART2_TX_PIN))
+// The DMA channel used for sending on a usart, NULL if it does not use DMA.
+static DMA_Channel_TypeDef *usartGetTxDmaChannel(int usartNr)
+{
+  switch(usartNr)
+  {
+    #ifdef USART1_TX_DMA
+    case DEV_USART1: return DMA1_Channel4;
+    #endif
+    #if (defined USART2_TX_DMA) && (defined USART2_TX_PIN)
+    case DEV_USART2: return DMA1_Channel7;
+    #endif
+    default : break;
+  }
+  return NULL;
+}
+
+// Called by serialDmaTxKick and serialDmaTxComplete.
+void serialDmaTxStart(int usartNr, const char *ptr, unsigned int len)
+{
+  DMA_Channel_TypeDef *dmaCh = usartGetTxDmaChannel(usartNr);
+
+  // The channel must be disabled while address and count are changed.
+  dmaCh->CCR &= ~DMA_CCR_EN;
+  dmaCh->CMAR = (uint32_t)ptr;
+  dmaCh->CNDTR = len;
+  dmaCh->CCR |= DMA_CCR_EN;
+}
+
+/**
+Set up DMA for sending on usart 1 or 2, see serialDma.h.
+Does nothing if that usart shall not use DMA.
+*/
+static void initUsartTxDma(int usartNr, USART_TypeDef *usartPtr)
+{
+	DMA_Channel_TypeDef *dmaCh = usartGetTxDmaChannel(usartNr);
+	if (dmaCh == NULL)
+	{
+		return;
+	}
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN_Msk;
+
+	// [3] chapter 11.6.7 DMA channel selection register (DMA_CSELR)
+	// Request number 2 is USART1_TX on channel 4 and USART2_TX on channel 7.
+	uint32_t tmp = DMA1_CSELR->CSELR;
+	int irqN;
+	switch (usartNr)
+	{
+	#ifdef USART1_TX_DMA
+	case DEV_USART1:
+		tmp &= ~DMA_CSELR_C4S_Msk;
+		tmp |= 2U << DMA_CSELR_C4S_Pos;
+		irqN = DMA1_Channel4_IRQn;
+		serialDmaTxInit(&usart1DmaTx, usartNr, &usart1Out);
+		break;
+	#endif
+	#if (defined USART2_TX_DMA) && (defined USART2_TX_PIN)
+	case DEV_USART2:
+		tmp &= ~DMA_CSELR_C7S_Msk;
+		tmp |= 2U << DMA_CSELR_C7S_Pos;
+		irqN = DMA1_Channel7_IRQn;
+		serialDmaTxInit(&usart2DmaTx, usartNr, &usart2Out);
+		break;
+	#endif
+	default:
+		return;
+	}
+	DMA1_CSELR->CSELR = tmp;
+
+	/*
+	 [3] chapter 11.6.3 DMA channel x configuration register (DMA_CCRx)
+	 DIR: read from memory, MINC: memory address is incremented,
+	 TCIE: interrupt when transfer is complete.
+	 PSIZE and MSIZE are left at zero, that is 8 bits.
+	 */
+	dmaCh->CCR = 0;
+	dmaCh->CPAR = (uint32_t)&usartPtr->TDR;
+	dmaCh->CCR = DMA_CCR_DIR | DMA_CCR_MINC | DMA_CCR_TCIE;
+
+	NVIC_SetPriority(irqN, (1UL << __NVIC_PRIO_BITS) - 1UL);
+	NVIC_EnableIRQ(irqN);
+
+	// DMAT: the usart requests a byte from DMA when TDR is empty.
+	usartPtr->CR3 |= USART_CR3_DMAT_Msk;
+}
+#endif
+
+#if (defined USART1_RX_DMA_SIZE) || (defined USART2_RX_DMA_SIZE)
+// The circular DMA receive buffer of a usart, NULL if it does not use DMA.
+static SerialDmaRx *usartGetDmaRx(int usartNr)
+{
+  switch(usartNr)
+  {
+    #ifdef USART1_RX_DMA_SIZE
+    case DEV_USART1: return &usart1DmaRx;
+    #endif
+    #ifdef USART2_RX_DMA_SIZE
+    case DEV_USART2: return &usart2DmaRx;
+    #endif
+    default : break;
+  }
+  return NULL;
+}
+
+// Called by serialDmaRxUpdate. DMA counts CNDTR down from buffer size
+// and then starts over (circular mode).
+unsigned int serialDmaRxGetWritePos(const SerialDmaRx *serialDmaRx)
+{
+  DMA_Channel_TypeDef *dmaCh = (serialDmaRx->usartNr == DEV_USART1) ? DMA1_Channel5 : DMA1_Channel6;
+  const unsigned int pos = serialDmaRx->size - dmaCh->CNDTR;
+  return (pos < serialDmaRx->size) ? pos : 0;
+}
+
+/**
+Set up circular DMA for receiving on usart 1 or 2, see serialDma.h.
+Returns zero if that usart shall not use DMA.
+*/
+static int initUsartRxDma(int usartNr, USART_TypeDef *usartPtr)
+{
+	SerialDmaRx *serialDmaRx = usartGetDmaRx(usartNr);
+	if (serialDmaRx == NULL)
+	{
+		return 0;
+	}
+
+	RCC->AHB1ENR |= RCC_AHB1ENR_DMA1EN_Msk;
+
+	// [3] chapter 11.6.7 DMA channel selection register (DMA_CSELR)
+	// Request number 2 is USART1_RX on channel 5 and USART2_RX on channel 6.
+	uint32_t tmp = DMA1_CSELR->CSELR;
+	DMA_Channel_TypeDef *dmaCh;
+	int irqN;
+	switch (usartNr)
+	{
+	#ifdef USART1_RX_DMA_SIZE
+	case DEV_USART1:
+		tmp &= ~DMA_CSELR_C5S_Msk;
+		tmp |= 2U << DMA_CSELR_C5S_Pos;
+		dmaCh = DMA1_Channel5;
+		irqN = DMA1_Channel5_IRQn;
+		serialDmaRxInit(serialDmaRx, usartNr, usart1DmaRxBuffer, sizeof(usart1DmaRxBuffer));
+		break;
+	#endif
+	#ifdef USART2_RX_DMA_SIZE
+	case DEV_USART2:
+		tmp &= ~DMA_CSELR_C6S_Msk;
+		tmp |= 2U << DMA_CSELR_C6S_Pos;
+		dmaCh = DMA1_Channel6;
+		irqN = DMA1_Channel6_IRQn;
+		serialDmaRxInit(serialDmaRx, usartNr, usart2DmaRxBuffer, sizeof(usart2DmaRxBuffer));
+		break;
+	#endif
+	default:
+		return 0;
+	}
+	DMA1_CSELR->CSELR = tmp;
+
+	/*
+	 [3] chapter 11.6.3 DMA channel x configuration register (DMA_CCRx)
+	 DIR is zero: read from peripheral. MINC: memory address is incremented,
+	 CIRC: start over at beginning of buffer when at end. HTIE and TCIE:
+	 interrupt at half and end of buffer, so that laps are counted.
+	 */
+	dmaCh->CCR = 0;
+	dmaCh->CPAR = (uint32_t)&usartPtr->RDR;
+	dmaCh->CMAR = (uint32_t)serialDmaRx->buffer;
+	dmaCh->CNDTR = serialDmaRx->size;
+	dmaCh->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_HTIE | DMA_CCR_TCIE;
+
+	NVIC_SetPriority(irqN, (1UL << __NVIC_PRIO_BITS) - 1UL);
+	NVIC_EnableIRQ(irqN);
+
+	dmaCh->CCR |= DMA_CCR_EN;
+
+	// DMAR: received bytes are moved by DMA instead of RXNE interrupt.
+	// EIE: interrupt on receive errors (with RXNEIE they come with RXNE).
+	usartPtr->CR3 |= USART_CR3_DMAR_Msk | USART_CR3_EIE_Msk;
+	return 1;
+}
+#endif
+
 #ifdef LPUART1_BAUDRATE
 int lpuartInit(uint32_t baud)
 {
@@ -336,9 +637,9 @@ int lpuartInit(uint32_t baud)
   */
 
   // Clear the in and out FIFOs
-  fifoInit(&lpuart1In);
+  fifoClear(&lpuart1In);
   #ifdef LPUART1_TX_PIN
-  fifoInit(&lpuart1Out);
+  fifoClear(&lpuart1Out);
   #endif
 
   // Enable Uart clock LPUART1EN
@@ -480,8 +781,10 @@ static int initUsart1or2(int usartNr, uint32_t baud)
 		 tmp |= ~(1 << 0);
 		 RCC->CCIPR = tmp;
 		 }*/
-		fifoInit(&usart1In);
-		fifoInit(&usart1Out);
+		#ifndef USART1_RX_DMA_SIZE
+		fifoClear(&usart1In);
+		#endif
+		fifoClear(&usart1Out);
 		RCC->APB2ENR |= RCC_APB2ENR_USART1EN_Msk;
 
 		// Configure IO pins.
@@ -506,9 +809,11 @@ static int initUsart1or2(int usartNr, uint32_t baud)
 		 tmp |= ~(1 << 2);
 		 RCC->CCIPR = tmp;
 		 }*/
-		fifoInit(&usart2In);
+		#ifndef USART2_RX_DMA_SIZE
+		fifoClear(&usart2In);
+		#endif
 		#ifdef USART2_TX_PIN
-		fifoInit(&usart2Out);
+		fifoClear(&usart2Out);
 		#endif
 		RCC->APB1ENR1 |= RCC_APB1ENR1_USART2EN_Msk;  // bit 17
 
@@ -577,6 +882,16 @@ static int initUsart1or2(int usartNr, uint32_t baud)
 	//USART2->CR3 &= ~(USART_CR3_SCEN_Msk | USART_CR3_HDSEL_Msk | USART_CR3_IREN_Msk);
 	usartPtr->CR2 &= ~(USART_CR2_CLKEN_Msk);
 
+	#if (defined USART1_TX_DMA) || ((defined USART2_TX_DMA) && (defined USART2_TX_PIN))
+	initUsartTxDma(usartNr, usartPtr);
+	#endif
+
+	#if (defined USART1_RX_DMA_SIZE) || (defined USART2_RX_DMA_SIZE)
+	const int rxDma = initUsartRxDma(usartNr, usartPtr);
+	#else
+	const int rxDma = 0;
+	#endif
+
 	systemBusyWait(1);
 
 	//Set Usart1 interrupt priority. Lower number is higher priority.
@@ -599,8 +914,16 @@ static int initUsart1or2(int usartNr, uint32_t baud)
 	 RXNEIE
 	 0: Interrupt is inhibited
 	 1: A USART interrupt is generated whenever ORE=1 or RXNE=1 in the USART_ISR
+	 With DMA the interrupt is instead when line becomes idle after receiving.
 	 */
-	usartPtr->CR1 |= USART_CR1_RXNEIE_Msk;
+	if (rxDma)
+	{
+		usartPtr->CR1 |= USART_CR1_IDLEIE_Msk;
+	}
+	else
+	{
+		usartPtr->CR1 |= USART_CR1_RXNEIE_Msk;
+	}
 
 	return 0;
 }
@@ -638,6 +961,9 @@ static inline void lpuart1Put(int ch)
 static inline void usart1Put(int ch)
 {
 	fifoPut(&usart1Out, ch);
+	#ifdef USART1_TX_DMA
+	serialDmaTxKick(&usart1DmaTx);
+	#else
 	/*
 	Now we need to trigger the ISR. Its done by enabling transmitter empty interrupt (it is empty so).
 	TXEIE
@@ -645,6 +971,7 @@ static inline void usart1Put(int ch)
 	1: A USART interrupt is generated whenever TXE=1 in the USART_ISR register
 	*/
 	USART1->CR1 |= USART_CR1_TXEIE_Msk;
+	#endif
 }
 
 
@@ -659,8 +986,12 @@ static inline void usart2Put(int ch)
 	//}
 
 	fifoPut(&usart2Out, ch);
+	#ifdef USART2_TX_DMA
+	serialDmaTxKick(&usart2DmaTx);
+	#else
 	// Now we need to trigger the ISR. Its done by enabling transmitter empty interrupt (it is empty so).
 	USART2->CR1 |= USART_CR1_TXEIE_Msk;
+	#endif
 }
 #endif
 
@@ -706,13 +1037,27 @@ int serialGetChar(int usartNr)
 			}
 			return -1;
 		#endif
+		#ifdef USART1_RX_DMA_SIZE
+		case DEV_USART1:
+		{
+			char ch;
+			return (serialDmaRxRead(&usart1DmaRx, &ch, 1) == 1) ? (unsigned char)ch : -1;
+		}
+		#else
 		case DEV_USART1:
 			if (!fifoIsEmpty(&usart1In))
 			{
 				return fifoTake(&usart1In);
 			}
 			return -1;
-		#ifdef USART2_BAUDRATE
+		#endif
+		#ifdef USART2_RX_DMA_SIZE
+		case DEV_USART2:
+		{
+			char ch;
+			return (serialDmaRxRead(&usart2DmaRx, &ch, 1) == 1) ? (unsigned char)ch : -1;
+		}
+		#elif (defined USART2_BAUDRATE)
 		case DEV_USART2:
 			if (!fifoIsEmpty(&usart2In))
 			{
@@ -730,86 +1075,252 @@ int serialGetChar(int usartNr)
 	}
 }
 
-#ifdef LPUART1_TX_PIN
-static inline void usartWriteLpuart1(const char *str, int msgLen)
+// Get as many received bytes as are available, up to maxLen.
+// Returns number of bytes given.
+int serialRead(int usartNr, char *buf, int maxLen)
 {
-	while (msgLen>0)
+	switch(usartNr)
 	{
-		lpuart1Put(*str++);
-	    msgLen--;
+		#ifdef LPUART1_BAUDRATE
+		case DEV_LPUART1:
+			return fifoTakeBlock(&lpuart1In, buf, maxLen);
+		#endif
+		#ifdef USART1_RX_DMA_SIZE
+		case DEV_USART1:
+			return serialDmaRxRead(&usart1DmaRx, buf, maxLen);
+		#else
+		case DEV_USART1:
+			return fifoTakeBlock(&usart1In, buf, maxLen);
+		#endif
+		#ifdef USART2_RX_DMA_SIZE
+		case DEV_USART2:
+			return serialDmaRxRead(&usart2DmaRx, buf, maxLen);
+		#elif (defined USART2_BAUDRATE)
+		case DEV_USART2:
+			return fifoTakeBlock(&usart2In, buf, maxLen);
+		#endif
+		#ifdef SOFTUART1_BAUDRATE
+		case DEV_SOFTUART1:
+		{
+			int n = 0;
+			while (n < maxLen)
+			{
+				const int ch = softUart1GetCh();
+				if (ch < 0)
+				{
+					break;
+				}
+				buf[n++] = ch;
+			}
+			return n;
+		}
+		#endif
+		default:
+			return 0;
+		break;
 	}
 }
-#endif
 
-static inline void usartWriteUart1(const char *str, int msgLen)
+// Gives received bytes without copying them. Returns the number of bytes
+// at ptr (there may be more, call again after serialSkip).
+int serialPeek(int usartNr, const char **ptr)
 {
-	while (msgLen>0)
+	switch(usartNr)
 	{
-		usart1Put(*str++);
-	    msgLen--;
+		#ifdef LPUART1_BAUDRATE
+		case DEV_LPUART1:
+			return fifoPeekBlock(&lpuart1In, ptr);
+		#endif
+		#ifdef USART1_RX_DMA_SIZE
+		case DEV_USART1:
+			return serialDmaRxPeek(&usart1DmaRx, ptr);
+		#else
+		case DEV_USART1:
+			return fifoPeekBlock(&usart1In, ptr);
+		#endif
+		#ifdef USART2_RX_DMA_SIZE
+		case DEV_USART2:
+			return serialDmaRxPeek(&usart2DmaRx, ptr);
+		#elif (defined USART2_BAUDRATE)
+		case DEV_USART2:
+			return fifoPeekBlock(&usart2In, ptr);
+		#endif
+		#if (defined SOFTUART1_BAUDRATE) && (defined SOFTUART1_RX_PIN)
+		case DEV_SOFTUART1:
+			return fifoPeekBlock(&bufferedSerialSoft1.inBuffer, ptr);
+		#endif
+		default:
+			return 0;
 	}
 }
 
-#ifdef USART2_TX_PIN
-static inline void usartWriteUart2(const char *str, int msgLen)
+// Remove n bytes given by serialPeek.
+void serialSkip(int usartNr, int n)
 {
-	while (msgLen>0)
+	switch(usartNr)
 	{
-		usart2Put(*str++);
-	    msgLen--;
+		#ifdef LPUART1_BAUDRATE
+		case DEV_LPUART1:
+			fifoSkip(&lpuart1In, n);
+			break;
+		#endif
+		#ifdef USART1_RX_DMA_SIZE
+		case DEV_USART1:
+			serialDmaRxSkip(&usart1DmaRx, n);
+			break;
+		#else
+		case DEV_USART1:
+			fifoSkip(&usart1In, n);
+			break;
+		#endif
+		#ifdef USART2_RX_DMA_SIZE
+		case DEV_USART2:
+			serialDmaRxSkip(&usart2DmaRx, n);
+			break;
+		#elif (defined USART2_BAUDRATE)
+		case DEV_USART2:
+			fifoSkip(&usart2In, n);
+			break;
+		#endif
+		#if (defined SOFTUART1_BAUDRATE) && (defined SOFTUART1_RX_PIN)
+		case DEV_SOFTUART1:
+			fifoSkip(&bufferedSerialSoft1.inBuffer, n);
+			break;
+		#endif
+		default:
+			break;
 	}
 }
-#endif
 
-#ifdef SOFTUART1_BAUDRATE
-static inline void usartWriteSoftUart1(const char *str, int msgLen)
+// The send buffer of a port, NULL if it has none.
+static volatile struct Fifo *serialGetOutFifo(int usartNr)
 {
-	while (msgLen>0)
+	switch(usartNr)
 	{
-		softUart1PutCh(*str++);
-	    msgLen--;
+		#ifdef LPUART1_TX_PIN
+		case DEV_LPUART1:
+			return &lpuart1Out;
+		#endif
+		case DEV_USART1:
+			return &usart1Out;
+		#ifdef USART2_TX_PIN
+		case DEV_USART2:
+			return &usart2Out;
+		#endif
+		#if (defined SOFTUART1_BAUDRATE) && (defined SOFTUART1_TX_PIN)
+		case DEV_SOFTUART1:
+			return &bufferedSerialSoft1.outBuffer;
+		#endif
+		default:
+			// Ignore this.
+		break;
 	}
+	return NULL;
 }
-#endif
 
-void serialWrite(int usartNr, const char *str, int msgLen)
+// Bytes have been put in the send buffer, make sure they get sent.
+static void serialStartSend(int usartNr)
 {
 	switch(usartNr)
 	{
 		#ifdef LPUART1_TX_PIN
 		case DEV_LPUART1:
-			usartWriteLpuart1(str, msgLen);
+			LPUART1->CR1 |= USART_CR1_TXEIE_Msk;
 			break;
 		#endif
 		case DEV_USART1:
-			usartWriteUart1(str, msgLen);
+			#ifdef USART1_TX_DMA
+			serialDmaTxKick(&usart1DmaTx);
+			#else
+			USART1->CR1 |= USART_CR1_TXEIE_Msk;
+			#endif
 			break;
 		#ifdef USART2_TX_PIN
 		case DEV_USART2:
-			usartWriteUart2(str, msgLen);
-			break;
-		#endif
-		#ifdef SOFTUART1_BAUDRATE
-		case DEV_SOFTUART1:
-			usartWriteSoftUart1(str, msgLen);
+			#ifdef USART2_TX_DMA
+			serialDmaTxKick(&usart2DmaTx);
+			#else
+			USART2->CR1 |= USART_CR1_TXEIE_Msk;
+			#endif
 			break;
 		#endif
 		default:
-			while (msgLen>0)
-			{
-			    serialPutChar(usartNr, *str++);
-			    msgLen--;
-			}
+			// Soft uart timer interrupt checks its buffer by itself.
 			break;
 	}
 }
 
+void serialWrite(int usartNr, const char *str, int msgLen)
+{
+	volatile struct Fifo *fifo = serialGetOutFifo(usartNr);
+	if (fifo == NULL)
+	{
+		while (msgLen>0)
+		{
+		    serialPutChar(usartNr, *str++);
+		    msgLen--;
+		}
+		return;
+	}
+	// Put all bytes first so that DMA can take them in one go.
+	fifoPutBlock(fifo, str, msgLen);
+	serialStartSend(usartNr);
+}
+
+// Like serialWrite but only as many bytes as there is room for are written
+// (none are dropped). Returns the number of bytes written.
+int serialTryWrite(int usartNr, const char *str, int msgLen)
+{
+	const int n = serialGetFreeSpaceWriteBuffer(usartNr);
+	if (msgLen > n)
+	{
+		msgLen = n;
+	}
+	serialWrite(usartNr, str, msgLen);
+	return msgLen;
+}
+
+// Write all spans or, if they do not fit in the send buffer, nothing.
+// So that a receiver gets whole frames or no frame instead of a broken one.
+// Returns 0 if written, -1 if dropped.
+int serialWriteFrame(int usartNr, const SerialSpan *spans, int nSpans)
+{
+	int len = 0;
+	for(int i = 0; i < nSpans; i++)
+	{
+		len += spans[i].len;
+	}
+	if (len > serialGetFreeSpaceWriteBuffer(usartNr))
+	{
+		if ((usartNr >= 0) && (usartNr < SERIAL_NOF_DEV))
+		{
+			serialCounters[usartNr].droppedFrames++;
+			serialCounters[usartNr].droppedBytes += len;
+		}
+		return -1;
+	}
+	volatile struct Fifo *fifo = serialGetOutFifo(usartNr);
+	if (fifo == NULL)
+	{
+		return -1;
+	}
+	for(int i = 0; i < nSpans; i++)
+	{
+		fifoPutBlock(fifo, spans[i].ptr, spans[i].len);
+	}
+	serialStartSend(usartNr);
+	return 0;
+}
+
 void serialPrint(int usartNr, const char *str)
 {
-  while(*str)
+  // Written as one block, with DMA that gives one transfer instead of one per character.
+  int n = 0;
+  while(str[n])
   {
-    serialPutChar(usartNr, *str++);
+    n++;
   }
+  serialWrite(usartNr, str, n);
 }
 
 void serialPrintInt64(int usartNr, int64_t num)
@@ -820,28 +1331,82 @@ void serialPrintInt64(int usartNr, int64_t num)
 }
 
 int serialGetFreeSpaceWriteBuffer(int usartNr)
+{
+	volatile struct Fifo *fifo = serialGetOutFifo(usartNr);
+	return (fifo != NULL) ? fifo_free_space(fifo) : 0;
+}
+
+// The receive buffer of a port, NULL if it has none (or uses DMA).
+static volatile struct Fifo *serialGetInFifo(int usartNr)
 {
 	switch(usartNr)
 	{
-		#ifdef LPUART1_TX_PIN
+		#ifdef LPUART1_BAUDRATE
 		case DEV_LPUART1:
-			fifoPut(&lpuart1Out, ch);
-			return fifo_free_space(&usart1Out);
+			return &lpuart1In;
 		#endif
+		#ifndef USART1_RX_DMA_SIZE
 		case DEV_USART1:
-			return fifo_free_space(&usart1Out);
-		#ifdef USART2_TX_PIN
+			return &usart1In;
+		#endif
+		#if (defined USART2_BAUDRATE) && (!defined USART2_RX_DMA_SIZE)
 		case DEV_USART2:
-			return fifo_free_space(&usart2Out);
+			return &usart2In;
 		#endif
-		#ifdef SOFTUART1_BAUDRATE
+		#if (defined SOFTUART1_BAUDRATE) && (defined SOFTUART1_RX_PIN)
 		case DEV_SOFTUART1:
-			return softUart1_free_space_out_buffer();
-			break;
+			return &bufferedSerialSoft1.inBuffer;
 		#endif
 		default:
-			// Ignore this.
 		break;
 	}
-	return 0;
+	return NULL;
+}
+
+void serialGetStats(int usartNr, SerialStats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	if ((usartNr < 0) || (usartNr >= SERIAL_NOF_DEV))
+	{
+		return;
+	}
+	*stats = serialCounters[usartNr];
+
+	volatile struct Fifo *out = serialGetOutFifo(usartNr);
+	if (out != NULL)
+	{
+		stats->txBytes = out->nOfBytes;
+		stats->txHighWater = out->highWater;
+		stats->txFullEvents = out->nOfFullEvents;
+		// Bytes given to serialWrite that did not fit.
+		stats->droppedBytes += out->nOfOverflows;
+	}
+
+	volatile struct Fifo *in = serialGetInFifo(usartNr);
+	if (in != NULL)
+	{
+		stats->rxBytes = in->nOfBytes;
+		stats->rxHighWater = in->highWater;
+		stats->rxFullEvents = in->nOfFullEvents;
+	}
+	#if (defined USART1_RX_DMA_SIZE) || (defined USART2_RX_DMA_SIZE)
+	else
+	{
+		const SerialDmaRx *dmaRx = usartGetDmaRx(usartNr);
+		if (dmaRx != NULL)
+		{
+			stats->rxBytes = dmaRx->nOfBytes;
+			stats->rxHighWater = dmaRx->highWater;
+			stats->rxFullEvents = dmaRx->nOfOverruns;
+		}
+	}
+	#endif
+
+	#if (defined SOFTUART1_BAUDRATE) && (defined SOFTUART1_RX_PIN)
+	if (usartNr == DEV_SOFTUART1)
+	{
+		stats->framingErrors = bufferedSerialSoft1.nOfFramingErrors;
+		stats->noiseErrors = bufferedSerialSoft1.nOfNoiseErrors;
+	}
+	#endif
 }
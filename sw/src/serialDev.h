@@ -10,15 +10,18 @@ http://www.eit.se/hb/misc/stm32/stm32l4xx/stm32_barebone/
 
 // TODO Rename this file to "serialDev.h"
 
-#ifndef __arm__
-#error
-#endif
-
+#if (defined __arm__)
 // TODO Can we replace some of these with forward declarations?
 #include "stm32l4xx.h"
 #include "stm32l432xx.h"
 #include "stm32l4xx_nucleo_32.h"
 #include "stm32l4xx_ll_adc.h"
+#elif (defined __linux__)
+// On linux the serial ports are simulated by linuxSim.c.
+#include <stdint.h>
+#else
+#error
+#endif
 #include "systemInit.h"
 
 // Support for Low Power Uart (LPUART) is not tested.
@@ -31,15 +34,58 @@ enum
   DEV_SOFTUART1 = 3,
 };
 
+#define SERIAL_NOF_DEV 4
+
+// A piece of a frame, see serialWriteFrame.
+typedef struct
+{
+	const char *ptr;
+	int len;
+} SerialSpan;
+
+// Counters per serial port, see serialGetStats.
+typedef struct
+{
+	// Bytes received (put in receive buffer) and bytes put in send buffer.
+	uint32_t rxBytes;
+	uint32_t txBytes;
+	// Usart interrupts (not counted for soft uart, its timer runs all the time).
+	uint32_t isrEntries;
+	// Receive errors, as flagged by the usart (ORE, FE and NE).
+	uint32_t overrunErrors;
+	uint32_t framingErrors;
+	uint32_t noiseErrors;
+	// The most bytes that have been waiting in the receive and send buffers.
+	uint16_t rxHighWater;
+	uint16_t txHighWater;
+	// Times a byte could not be put in the buffer since it was full. When
+	// receiving with DMA, times DMA wrote over bytes not yet read.
+	uint32_t rxFullEvents;
+	uint32_t txFullEvents;
+	// Frames not sent by serialWriteFrame since they did not fit.
+	uint32_t droppedFrames;
+	// Bytes not sent since there was no room for them in the send buffer.
+	// Includes the bytes of dropped frames.
+	uint32_t droppedBytes;
+} SerialStats;
+
+#if (defined __arm__)
 void setupIoPinTx(GPIO_TypeDef *base, uint32_t pin, uint32_t alternateFunction);
 void setupIoPinRx(GPIO_TypeDef *base, uint32_t pin, uint32_t alternateFunction);
+#endif
 
 int serialInit(int usartNr, uint32_t baud);
 void serialPutChar(int usartNr, int ch);
 int serialGetChar(int usartNr);
+int serialRead(int usartNr, char *buf, int maxLen);
+int serialPeek(int usartNr, const char **ptr);
+void serialSkip(int usartNr, int n);
 void serialWrite(int usartNr, const char *str, int msgLen);
+int serialTryWrite(int usartNr, const char *str, int msgLen);
+int serialWriteFrame(int usartNr, const SerialSpan *spans, int nSpans);
 void serialPrint(int usartNr, const char *str);
 void serialPrintInt64(int usartNr, int64_t num);
 int serialGetFreeSpaceWriteBuffer(int usartNr);
+void serialGetStats(int usartNr, SerialStats *stats);
 
 #endif
@@ -0,0 +1,153 @@
+/*
+serialDma.c
+
+Hardware independent part of sending and receiving on a serial port
+using DMA, see serialDma.h.
+
+*/
+
+#include "systemInit.h"
+#include "serialDma.h"
+
+
+void serialDmaTxInit(SerialDmaTx *serialDmaTx, int usartNr, volatile struct Fifo *fifo)
+{
+	serialDmaTx->fifo = fifo;
+	serialDmaTx->usartNr = usartNr;
+	serialDmaTx->dmaLen = 0;
+}
+
+// Give next contiguous region of the Fifo to the DMA.
+// Interrupts must be disabled or this called from the interrupt.
+static void serialDmaTxStartNext(SerialDmaTx *serialDmaTx)
+{
+	// The region may not wrap, if it does the rest is sent in next transfer.
+	const char *ptr;
+	const int len = fifoPeekBlock(serialDmaTx->fifo, &ptr);
+	if (len == 0)
+	{
+		return;
+	}
+	serialDmaTx->dmaLen = len;
+	serialDmaTxStart(serialDmaTx->usartNr, ptr, len);
+}
+
+void serialDmaTxKick(SerialDmaTx *serialDmaTx)
+{
+	system_disable_interrupts();
+	if (serialDmaTx->dmaLen == 0)
+	{
+		serialDmaTxStartNext(serialDmaTx);
+	}
+	system_enable_interrupts();
+}
+
+void serialDmaTxComplete(SerialDmaTx *serialDmaTx)
+{
+	// The bytes are sent, now they may be overwritten.
+	fifoSkip(serialDmaTx->fifo, serialDmaTx->dmaLen);
+	serialDmaTx->dmaLen = 0;
+	serialDmaTxStartNext(serialDmaTx);
+}
+
+
+
+void serialDmaRxInit(SerialDmaRx *serialDmaRx, int usartNr, char *buffer, unsigned int size)
+{
+	serialDmaRx->buffer = buffer;
+	serialDmaRx->size = size;
+	serialDmaRx->readPos = 0;
+	serialDmaRx->usartNr = usartNr;
+	serialDmaRx->nOfWritten = 0;
+	serialDmaRx->writePos = 0;
+	serialDmaRx->nOfBytes = 0;
+	serialDmaRx->highWater = 0;
+	serialDmaRx->nOfOverruns = 0;
+	serialDmaRx->nOfLostBytes = 0;
+}
+
+void serialDmaRxUpdate(SerialDmaRx *serialDmaRx)
+{
+	// DMA has written from writePos up to where it is now, it may have
+	// started over at beginning of buffer since then.
+	const unsigned int writePos = serialDmaRxGetWritePos(serialDmaRx);
+	serialDmaRx->nOfWritten += (writePos + serialDmaRx->size - serialDmaRx->writePos) % serialDmaRx->size;
+	serialDmaRx->writePos = writePos;
+}
+
+// Returns number of received bytes not yet taken. If DMA has come round
+// to readPos they are (being) written over, then they are dropped, reading
+// starts over at where DMA is writing and zero is returned.
+static unsigned int serialDmaRxUnread(SerialDmaRx *serialDmaRx)
+{
+	system_disable_interrupts();
+	serialDmaRxUpdate(serialDmaRx);
+	const uint32_t nOfWritten = serialDmaRx->nOfWritten;
+	const unsigned int writePos = serialDmaRx->writePos;
+	system_enable_interrupts();
+
+	const uint32_t unread = nOfWritten - serialDmaRx->nOfBytes - serialDmaRx->nOfLostBytes;
+	if (unread >= serialDmaRx->size)
+	{
+		serialDmaRx->nOfOverruns++;
+		serialDmaRx->nOfLostBytes += unread;
+		serialDmaRx->readPos = writePos;
+		return 0;
+	}
+	return unread;
+}
+
+int serialDmaRxPeek(SerialDmaRx *serialDmaRx, const char **ptr)
+{
+	const unsigned int used = serialDmaRxUnread(serialDmaRx);
+	if (used > serialDmaRx->highWater)
+	{
+		serialDmaRx->highWater = used;
+	}
+	const unsigned int readPos = serialDmaRx->readPos;
+	const unsigned int toEnd = serialDmaRx->size - readPos;
+	*ptr = serialDmaRx->buffer + readPos;
+	return (used < toEnd) ? used : toEnd;
+}
+
+void serialDmaRxSkip(SerialDmaRx *serialDmaRx, unsigned int n)
+{
+	// If DMA came round to the bytes while they were used they may have
+	// been changed, then they are counted as lost instead.
+	if (serialDmaRxUnread(serialDmaRx) < n)
+	{
+		return;
+	}
+	unsigned int readPos = serialDmaRx->readPos + n;
+	if (readPos >= serialDmaRx->size)
+	{
+		readPos -= serialDmaRx->size;
+	}
+	serialDmaRx->readPos = readPos;
+	serialDmaRx->nOfBytes += n;
+}
+
+int serialDmaRxRead(SerialDmaRx *serialDmaRx, char *buf, int maxLen)
+{
+	// Received bytes may wrap at end of buffer, if so it takes two blocks.
+	int n = 0;
+	while (n < maxLen)
+	{
+		const char *ptr;
+		int len = serialDmaRxPeek(serialDmaRx, &ptr);
+		if (len == 0)
+		{
+			break;
+		}
+		if (len > maxLen - n)
+		{
+			len = maxLen - n;
+		}
+		for(int i = 0; i < len; i++)
+		{
+			buf[n++] = ptr[i];
+		}
+		serialDmaRxSkip(serialDmaRx, len);
+	}
+	return n;
+}
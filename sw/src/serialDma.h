@@ -0,0 +1,95 @@
+/*
+serialDma.h
+
+Hardware independent part of sending and receiving on a serial port
+using DMA.
+
+Bytes to send are put in a Fifo as usual. Instead of one TXE interrupt
+per byte the bytes from tail and forward (up to head or end of the
+Fifo buffer, whichever comes first) are given to the DMA channel in one
+go. When the DMA says it is done (transfer complete interrupt) tail is
+moved past those bytes and next region, if any, is started.
+
+When receiving the DMA runs in circular mode, it writes received bytes
+into a buffer over and over again. Received bytes are those between where
+we have read (readPos) and where DMA is writing. Bytes are read directly
+from the buffer, see serialDmaRxPeek. There are no interrupts per byte, the
+usart idle line interrupt tells that a burst of bytes has ended and the DMA
+half and full transfer interrupts come at least once per half buffer. They
+keep count of how many bytes DMA has written (nOfWritten). The buffer must be large enough for what can arrive
+while the main loop is busy. If it is not, DMA comes round and writes over
+bytes not yet read. That is counted as an overrun, the unread bytes are
+dropped and reading starts over at where DMA is writing.
+
+The DMA channels are handled by serialDmaTxStart and serialDmaRxGetWritePos,
+those are in serialDev.c on target and in linuxSim.c when running on a PC.
+
+*/
+
+#ifndef SERIALDMA_H
+#define SERIALDMA_H
+
+#include <stdint.h>
+#include "fifo.h"
+
+typedef struct
+{
+	volatile struct Fifo *fifo;
+	int usartNr;
+	// Number of bytes given to the DMA and not yet sent, zero if DMA is idle.
+	volatile uint16_t dmaLen;
+} SerialDmaTx;
+
+void serialDmaTxInit(SerialDmaTx *serialDmaTx, int usartNr, volatile struct Fifo *fifo);
+
+// Call this after bytes have been put in the Fifo. If the DMA is idle it is started.
+void serialDmaTxKick(SerialDmaTx *serialDmaTx);
+
+// To be called from the DMA transfer complete interrupt.
+void serialDmaTxComplete(SerialDmaTx *serialDmaTx);
+
+// Shall start a DMA transfer of len bytes from ptr to the transmit data
+// register of the serial port. Implemented by the serial driver.
+void serialDmaTxStart(int usartNr, const char *ptr, unsigned int len);
+
+
+typedef struct
+{
+	char *buffer;
+	uint16_t size;
+	uint16_t readPos;
+	int usartNr;
+	// Bytes written by DMA in total and where DMA was writing, as of last
+	// serialDmaRxUpdate.
+	volatile uint32_t nOfWritten;
+	volatile uint16_t writePos;
+	// Number of bytes taken and the most bytes seen waiting in the buffer.
+	uint32_t nOfBytes;
+	uint16_t highWater;
+	// Times DMA wrote over bytes not yet taken and the bytes lost that way.
+	uint32_t nOfOverruns;
+	uint32_t nOfLostBytes;
+} SerialDmaRx;
+
+void serialDmaRxInit(SerialDmaRx *serialDmaRx, int usartNr, char *buffer, unsigned int size);
+
+// Gives received bytes that are in one piece in the buffer, returns number
+// of bytes at ptr. Call serialDmaRxSkip when they have been used.
+int serialDmaRxPeek(SerialDmaRx *serialDmaRx, const char **ptr);
+
+void serialDmaRxSkip(SerialDmaRx *serialDmaRx, unsigned int n);
+
+// Copy up to maxLen received bytes, returns number of bytes given.
+int serialDmaRxRead(SerialDmaRx *serialDmaRx, char *buf, int maxLen);
+
+// To be called from the usart idle line interrupt and from the DMA half
+// transfer and transfer complete interrupts, so that a lap is not missed it
+// must be called at least once per half buffer.
+// Interrupts must be disabled or this called from the interrupt.
+void serialDmaRxUpdate(SerialDmaRx *serialDmaRx);
+
+// Shall give the position in buffer where DMA will write next byte.
+// Implemented by the serial driver.
+unsigned int serialDmaRxGetWritePos(const SerialDmaRx *serialDmaRx);
+
+#endif
@@ -12,14 +12,17 @@ It will use one IO pin to show status and error.
 #ifndef SYSTEMINIT_H
 #define SYSTEMINIT_H
 
+#if (defined __arm__)
 // TODO Can we replace some of these with forward declarations?
 #include "stm32l4xx.h"
 #include "stm32l432xx.h"
 #include "stm32l4xx_nucleo_32.h"
 #include "stm32l4xx_ll_adc.h"
-
-#ifndef __arm__
-#error This only works with arm CPUs.
+#elif (defined __linux__)
+// On linux this is implemented by linuxSim.c, see also "make host".
+#include <stdint.h>
+#else
+#error This only works with arm CPUs or as a linux simulation.
 #endif
 
 
@@ -59,6 +62,7 @@ enum
  * This also needs to be changed if the application is to use this pin 
  * for something else.
  */
+#if (defined __arm__)
 #define SYS_LED_PORT GPIOB
 #define SYS_LED_PIN 3
 
@@ -68,6 +72,11 @@ enum
 void systemPinOutInit(GPIO_TypeDef* port, int pin);
 void systemPinOutSetHigh(GPIO_TypeDef* port, int pin); // For Green system LED this is On
 void systemPinOutSetLow(GPIO_TypeDef* port, int pin); // For Green system LED this is Off
+#else
+// There is no LED in the simulation.
+#define SYS_LED_ON()
+#define SYS_LED_OFF()
+#endif
 
 /**
  * Application functions can call this to get the system tick counter.
@@ -104,6 +113,10 @@ void systemErrorHandler(int errorCode);
 #ifdef __AVR_ATmega328P__
 #define system_disable_interrupts() cli()
 #define system_enable_interrupts() sei()
+#elif (defined __linux__)
+// The simulation is single threaded, there are no interrupts to disable.
+#define system_disable_interrupts()
+#define system_enable_interrupts()
 #else
 #define system_disable_interrupts() __disable_irq()
 #define system_enable_interrupts() __enable_irq()
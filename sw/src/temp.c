@@ -42,6 +42,7 @@ Henrik
 #include "portsGpio.h"
 #include "eeprom.h"
 #include "messageUtilities.h"
+#include "messageSchema.h"
 #include "temp.h"
 
 
@@ -126,15 +127,11 @@ static void sendTempMessage(int temp1_C, int temp2_C)
 	// This will typically be sent on usart1 (opto link)
 	// This needs to match the unpacking in fanProcessExtTempStatusMsg.
 	// If changes are made here check if that needs to be changed also.
-	messageInitAndAddCategoryAndSender(&messageDbfTmpBuffer, STATUS_CATEGORY);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, TEMP_STATUS_MSG);
-	DbfSerializerWriteInt64(&messageDbfTmpBuffer, systemGetSysTimeMs());
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, temp1_C);
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, temp2_C);
 #ifdef TEMP_INTERNAL_ADC_CHANNEL
-	DbfSerializerWriteInt32(&messageDbfTmpBuffer, tempInternal_C);
+	statusMsgSendTemp(&messageDbfTmpBuffer, systemGetSysTimeMs(), temp1_C, temp2_C, tempInternal_C);
+#else
+	statusMsgSendTemp(&messageDbfTmpBuffer, systemGetSysTimeMs(), temp1_C, temp2_C);
 #endif
-	messageSendDbf(&messageDbfTmpBuffer);
 }
 #endif
 
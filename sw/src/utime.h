@@ -0,0 +1,17 @@
+/*
+utime.h
+
+Time in micro seconds, used by Dbf.c for receive timeouts.
+
+*/
+
+#ifndef UTIME_H
+#define UTIME_H
+
+#include <stdint.h>
+
+// Time in micro seconds. In the linux simulation this follows the
+// simulated milli second clock so that it agrees with systemGetSysTimeMs.
+int64_t buf_time_us();
+
+#endif